@@ -13,6 +13,8 @@ extern int SDL_Init(Uint32 flags);
 extern Uint32 SDL_WasInit(Uint32 flags);
 extern void SDL_QuitSubSystem(Uint32 flags);
 
+extern Uint64 SDL_GetTicksNS(void);
+
 extern void SDL_StartTextInput(void);
 
 #endif /* SDL_h_ */
@@ -62,6 +62,8 @@ typedef enum SDL_EventType
 	SDL_EVENT_GAMEPAD_UPDATE_COMPLETE,      /**< Gamepad update is complete */
 	SDL_EVENT_GAMEPAD_STEAM_HANDLE_UPDATED,  /**< Gamepad Steam handle has changed */
 
+	SDL_EVENT_FIRST = 0,     /**< First event type, for SDL_PeepEvents() ranges */
+	SDL_EVENT_LAST = 0xFFFF  /**< Last event type, for SDL_PeepEvents() ranges */
 } SDL_EventType;
 
 typedef struct {
@@ -98,11 +100,13 @@ typedef struct {
 
 		/**< Gamepad button event data */
 		struct {
+			SDL_JoystickID which; /**< The joystick instance id */
 			uint8_t button;
 		} cbutton;
 
 		/**< Gamepad axis event data */
 		struct {
+			SDL_JoystickID which; /**< The joystick instance id */
 			uint8_t axis;
 			int16_t value;
 		} gaxis;
@@ -141,6 +145,195 @@ typedef struct {
 	};	
 } SDL_Event;
 
+/**
+ * Event queues, one per device class.
+ *
+ * Events are routed to a queue by type, so each class can be drained by its
+ * own thread. Joystick, gamepad and any other events share the gamepad queue.
+ */
+typedef enum SDL_EventQueue
+{
+	SDL_EVENT_QUEUE_KEYBOARD,	/**< SDL_EVENT_KEY_* events */
+	SDL_EVENT_QUEUE_MOUSE,		/**< SDL_EVENT_MOUSE_* events */
+	SDL_EVENT_QUEUE_GAMEPAD,	/**< Joystick, gamepad and other events */
+	SDL_EVENT_QUEUE_COUNT
+} SDL_EventQueue;
+
+/**
+ * Poll for the oldest pending event of any class.
+ *
+ * The per-class queues are merged in timestamp order.
+ *
+ * \returns SDL_TRUE if an event was copied to `event`, SDL_FALSE if there
+ *          are no pending events.
+ */
 extern DECLSPEC SDL_bool SDLCALL SDL_PollEvent(SDL_Event *event);
 
+/**
+ * Poll for the oldest pending event of one device class.
+ *
+ * Every queue must be drained by a single thread at a time: do not mix this
+ * with SDL_PollEvent() from another thread.
+ *
+ * \returns SDL_TRUE if an event was copied to `event`, SDL_FALSE if the
+ *          queue is empty.
+ */
+extern DECLSPEC SDL_bool SDLCALL SDL_PollQueueEvent(SDL_EventQueue queue, SDL_Event *event);
+
+typedef enum SDL_eventaction
+{
+	SDL_ADDEVENT,	/**< Add events to the back of the queue. */
+	SDL_PEEKEVENT,	/**< Check but don't remove events from the queue front. */
+	SDL_GETEVENT	/**< Retrieve/remove events from the front of the queue. */
+} SDL_eventaction;
+
+/**
+ * Wait until there is a pending event.
+ *
+ * The calling thread sleeps until a producer enqueues an event. If `event`
+ * is not NULL the next event is removed and copied to it.
+ *
+ * \returns SDL_TRUE on success, SDL_FALSE if the event system is not
+ *          initialized.
+ */
+extern DECLSPEC SDL_bool SDLCALL SDL_WaitEvent(SDL_Event *event);
+
+/**
+ * Wait until there is a pending event or `timeoutMS` milliseconds passed.
+ *
+ * A negative timeout waits forever, zero behaves like SDL_PollEvent().
+ *
+ * \returns SDL_TRUE if there was an event, SDL_FALSE on timeout.
+ */
+extern DECLSPEC SDL_bool SDLCALL SDL_WaitEventTimeout(SDL_Event *event, Sint32 timeoutMS);
+
+/**
+ * Get a file descriptor to integrate the event queues with select()/poll().
+ *
+ * The descriptor becomes readable when an event arrives after the queues
+ * were drained. Once it is readable, call SDL_PollEvent() or SDL_PeepEvents()
+ * until they return no more events, which re-arms it. With SDL_PollQueueEvent()
+ * it is re-armed when a poll finds every queue empty. Do not read from or
+ * close the descriptor.
+ *
+ * \returns a file descriptor or -1 on error.
+ */
+extern DECLSPEC int SDLCALL SDL_GetEventFD(void);
+
+/**
+ * Enable or disable coalescing of motion events.
+ *
+ * When enabled, a mouse motion event is merged into a still pending one by
+ * adding up `xrel`/`yrel`, and a gamepad axis event replaces the
+ * value of a pending event for the same `which`/`axis`. Events are never
+ * merged across a button, key or any other event, so their order is kept.
+ * The merged event keeps the timestamp of the first one.
+ *
+ * Coalescing is disabled by default. Call after SDL_Init().
+ */
+extern DECLSPEC void SDLCALL SDL_SetEventCoalescing(SDL_bool enabled);
+
+/**
+ * Get the largest number of events a queue held at once since SDL_Init().
+ *
+ * Events are stored in slots preallocated by SDL_Init(), so this tells how
+ * much of EVENT_QUEUE_SIZE (see SDL_GetDroppedEventCount()) is really used.
+ */
+extern DECLSPEC Uint32 SDLCALL SDL_GetEventQueueHighWater(SDL_EventQueue queue);
+
+/**
+ * Get the number of events of a type dropped because their queue was full.
+ *
+ * Each queue holds EVENT_QUEUE_SIZE events (1024 by default, rounded up to a
+ * power of two). When one is full, EVENT_QUEUE_POLICY selects what happens:
+ * "newest" drops the new event (default), "oldest" drops the event at the
+ * front of the queue and "coalesce" merges the new event into a pending one
+ * like SDL_SetEventCoalescing() does, dropping it if that is not possible.
+ * Both are read from the environment by SDL_Init().
+ *
+ * Each queue counts the first 16 types that drop events separately. Types
+ * dropping events after that share one counter, this function returns the
+ * total of all of them for any such type.
+ */
+extern DECLSPEC Uint32 SDLCALL SDL_GetDroppedEventCount(Uint32 type);
+
+/**
+ * Event classes with their own input latency figures.
+ *
+ * Joystick events are not queued, they only feed the gamepad events, so they
+ * have no class of their own.
+ */
+typedef enum SDL_EventClass
+{
+	SDL_EVENT_CLASS_KEYBOARD,	/**< SDL_EVENT_KEY_* events */
+	SDL_EVENT_CLASS_MOUSE,		/**< SDL_EVENT_MOUSE_* events */
+	SDL_EVENT_CLASS_GAMEPAD,	/**< SDL_EVENT_GAMEPAD_* events */
+	SDL_EVENT_CLASS_COUNT
+} SDL_EventClass;
+
+/**
+ * Input latency of the events of one class, in nanoseconds.
+ *
+ * Percentiles are read from a log-linear histogram and are accurate to
+ * 1/8 of their value.
+ */
+typedef struct SDL_EventLatencyStats
+{
+	Uint64 count;	/**< Number of events recorded */
+	Uint64 p50_ns;	/**< Median latency */
+	Uint64 p99_ns;	/**< 99th percentile latency */
+	Uint64 max_ns;	/**< Largest latency, saturates at about 4.3 seconds */
+} SDL_EventLatencyStats;
+
+/**
+ * Enable or disable recording of input latency.
+ *
+ * The latency of an event is the time from the arrival of the HID report
+ * it was made of (its timestamp) until SDL_PollEvent(), SDL_PeepEvents()
+ * with SDL_GETEVENT or SDL_PollQueueEvent() takes it out of its queue.
+ *
+ * Recording is disabled by default. Setting the 0x400 bit of LOGMASK
+ * enables it in SDL_Init() and logs the figures on SDL_QuitSubSystem().
+ */
+extern DECLSPEC void SDLCALL SDL_SetEventLatencyStats(SDL_bool enabled);
+
+/**
+ * Get the input latency recorded for a class of events.
+ *
+ * \returns 0 on success or a negative value if `cls` is invalid.
+ */
+extern DECLSPEC int SDLCALL SDL_GetEventLatencyStats(SDL_EventClass cls, SDL_EventLatencyStats *stats);
+
+/**
+ * Clear the recorded input latency of all classes.
+ */
+extern DECLSPEC void SDLCALL SDL_ResetEventLatencyStats(void);
+
+/**
+ * Check the event queues for events and optionally return them.
+ *
+ * With SDL_PEEKEVENT or SDL_GETEVENT up to `numevents` events with a type
+ * between `minType` and `maxType` are copied to `events` in timestamp order.
+ * SDL_GETEVENT also removes them, releasing the whole run of every queue at
+ * once. Events leave each queue in order: an event of another type at the
+ * front of a queue hides the events queued behind it until it is polled.
+ *
+ * With SDL_ADDEVENT the `numevents` events in `events` are pushed with
+ * SDL_PushEvent().
+ *
+ * \returns the number of events copied or added.
+ */
+extern DECLSPEC int SDLCALL SDL_PeepEvents(SDL_Event *events, int numevents, SDL_eventaction action, Uint32 minType, Uint32 maxType);
+
+/**
+ * Add an event to the event queue.
+ *
+ * The event is copied into the queue of its class, so it may live on the
+ * caller's stack. A zero timestamp is replaced with SDL_GetTicksNS().
+ *
+ * \returns 1 on success, 0 if the event queue is not initialized or
+ *          a negative value if the queue is full.
+ */
+extern DECLSPEC int SDLCALL SDL_PushEvent(SDL_Event *event);
+
 #endif /* SDL_events_h_ */
\ No newline at end of file
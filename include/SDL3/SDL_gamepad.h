@@ -283,6 +283,7 @@ extern DECLSPEC int SDLCALL SDL_AddGamepadMapping(const char *mapping);
  * \sa SDL_GetGamepadMappingForGUID
  */
 extern DECLSPEC int SDLCALL SDL_AddGamepadMappingsFromRW(SDL_RWops *src, SDL_bool freesrc);
+#endif
 
 /**
  * Load a set of gamepad mappings from a file.
@@ -295,7 +296,17 @@ extern DECLSPEC int SDLCALL SDL_AddGamepadMappingsFromRW(SDL_RWops *src, SDL_boo
  *
  * Mappings not belonging to the current platform or with no platform field
  * specified will be ignored (i.e. mappings for Linux will be ignored in
- * Windows, etc).
+ * Windows, etc). On QNX the "Windows" mappings are used, the button and axis
+ * numbers of their DirectInput GUIDs follow the HID report order like the
+ * joysticks of this backend. Only the USB GUIDs without a driver signature
+ * built by this backend are kept, so XInput, RawInput and other driver
+ * specific entries that could never match are skipped.
+ *
+ * The file is mapped into memory while it is processed, only the mappings
+ * kept take memory afterwards.
+ *
+ * The SDL_GAMECONTROLLERCONFIG_FILE environment variable names a file loaded
+ * this way when the gamepad subsystem initializes.
  *
  * \param file the mappings file to load
  * \returns the number of mappings added or -1 on error; call SDL_GetError()
@@ -304,11 +315,29 @@ extern DECLSPEC int SDLCALL SDL_AddGamepadMappingsFromRW(SDL_RWops *src, SDL_boo
  * \since This function is available since SDL 3.0.0.
  *
  * \sa SDL_AddGamepadMapping
- * \sa SDL_AddGamepadMappingsFromRW
- * \sa SDL_GetGamepadMappingForGUID
+ * \sa SDL_AddGamepadMappingsFromMemory
  */
 extern DECLSPEC int SDLCALL SDL_AddGamepadMappingsFromFile(const char *file);
 
+/**
+ * Load a set of gamepad mappings from a text buffer.
+ *
+ * The buffer holds one mapping per line, like SDL_AddGamepadMappingsFromFile()
+ * reads. It is only read and doesn't need to be NUL terminated. Lines
+ * starting with '#' are ignored, and so are mappings filtered out by their
+ * platform field or GUID.
+ *
+ * \param mem the mappings text
+ * \param size the size of the text in bytes
+ * \returns the number of mappings added or -1 on error; call SDL_GetError()
+ *          for more information.
+ *
+ * \sa SDL_AddGamepadMapping
+ * \sa SDL_AddGamepadMappingsFromFile
+ */
+extern DECLSPEC int SDLCALL SDL_AddGamepadMappingsFromMemory(const void *mem, size_t size);
+
+#if 0
 /**
  * Reinitialize the SDL mapping database to its initial state.
  *
@@ -1068,6 +1097,39 @@ extern DECLSPEC SDL_bool SDLCALL SDL_GamepadHasButton(SDL_Gamepad *gamepad, SDL_
  */
 extern DECLSPEC Uint8 SDLCALL SDL_GetGamepadButton(SDL_Gamepad *gamepad, SDL_GamepadButton button);
 
+/**
+ * The state of all axes and buttons of a gamepad.
+ */
+typedef struct SDL_GamepadState
+{
+	Uint64 timestamp;			/**< In nanoseconds, of the last change */
+	Sint16 axes[SDL_GAMEPAD_AXIS_MAX];	/**< Indexed by SDL_GamepadAxis */
+	Uint8 buttons[SDL_GAMEPAD_BUTTON_MAX];	/**< Indexed by SDL_GamepadButton */
+} SDL_GamepadState;
+
+/**
+ * Get the current state of all axes and buttons of a gamepad at once.
+ *
+ * Axes and buttons hold the values of the last gamepad events sent for them,
+ * like SDL_GetGamepadAxis() and SDL_GetGamepadButton() return. They start
+ * from the joystick state when the gamepad is opened. Unlike separate calls
+ * to those, the snapshot is consistent: it never mixes values from before and
+ * after an update.
+ *
+ * This function and SDL_GetGamepadAxis() and SDL_GetGamepadButton() don't take
+ * the joystick lock. They must not be called while another thread may close
+ * the gamepad with SDL_CloseGamepad().
+ *
+ * \param gamepad a gamepad
+ * \param state the structure to fill
+ * \returns 0 on success or a negative error code on failure; call
+ *          SDL_GetError() for more information.
+ *
+ * \sa SDL_GetGamepadAxis
+ * \sa SDL_GetGamepadButton
+ */
+extern DECLSPEC int SDLCALL SDL_GetGamepadState(SDL_Gamepad *gamepad, SDL_GamepadState *state);
+
 /**
  * Get the label of a button on a gamepad.
  *
@@ -7,6 +7,12 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define _guarded 
 
@@ -15,6 +21,9 @@
 /* Many gamepads turn the center button into an instantaneous button press */
 #define SDL_MINIMUM_GUIDE_BUTTON_DELAY_MS 250
 
+/* Lock free attempts of SDL_GetGamepadState() before it waits for the joystick lock */
+#define SDL_GAMEPAD_STATE_TRIES 4
+
 #define SDL_GAMEPAD_CRC_FIELD		   "crc:"
 #define SDL_GAMEPAD_CRC_FIELD_SIZE	  4 /* hard-coded for speed */
 #define SDL_GAMEPAD_TYPE_FIELD		  "type:"
@@ -23,6 +32,12 @@
 #define SDL_GAMEPAD_FACE_FIELD_SIZE	 5 /* hard-coded for speed */
 #define SDL_GAMEPAD_PLATFORM_FIELD	  "platform:"
 #define SDL_GAMEPAD_PLATFORM_FIELD_SIZE SDL_strlen(SDL_GAMEPAD_PLATFORM_FIELD)
+#ifndef SDL_GAMEPAD_MAPPING_PLATFORM
+/* Joystick GUIDs are built like the DirectInput ones, pick those mappings from databases */
+#define SDL_GAMEPAD_MAPPING_PLATFORM	"Windows"
+#endif
+#define SDL_GAMEPAD_MAPPING_GUID_SIZE	32
+#define SDL_GAMEPAD_MAPPING_LINE_MAX	1024
 #define SDL_GAMEPAD_HINT_FIELD		  "hint:"
 #define SDL_GAMEPAD_HINT_FIELD_SIZE	 SDL_strlen(SDL_GAMEPAD_HINT_FIELD)
 #define SDL_GAMEPAD_SDKGE_FIELD		 "sdk>=:"
@@ -46,10 +61,50 @@ typedef struct GamepadMapping_t
 	SDL_JoystickGUID guid _guarded;
 	char *name _guarded;
 	char *mapping _guarded;
+	SDL_bool mapping_is_static _guarded; /* mapping points into s_GamepadMappings */
+	Uint16 crc _guarded; /* parsed from the mapping's crc field */
+	int num_bindings _guarded;
+	SDL_GamepadBinding *bindings _guarded; /* parsed from mapping by the first gamepad using it */
 	SDL_GamepadMappingPriority priority _guarded;
 	struct GamepadMapping_t *next _guarded;
+	struct GamepadMapping_t *hash_next _guarded; /* next mapping in the same index bucket */
 } GamepadMapping_t;
 
+/*
+ * Built-in mapping in the compiled database, looked up by GUID instead of
+ * being added at startup. The GUID is the one written in the mapping.
+ */
+typedef struct GamepadDBEntry
+{
+	Uint8 guid[16];
+	Uint16 index; /* into s_GamepadMappings */
+} GamepadDBEntry;
+
+#include "SDL_gamepad_db_hash.h"
+#include "SDL_gamepad_names.h"
+#include "SDL_gamepad_db_index.h"
+
+SDL_COMPILE_TIME_ASSERT(gamepad_db_index, SDL_arraysize(s_GamepadMappings) == SDL_GAMEPAD_DB_MAPPINGS + 1);
+
+/* Binding lookup tables, built when a mapping is loaded */
+enum
+{
+	GAMEPAD_TABLE_AXIS,		/* by joystick axis */
+	GAMEPAD_TABLE_BUTTON,		/* by joystick button */
+	GAMEPAD_TABLE_HAT,		/* by joystick hat */
+	GAMEPAD_TABLE_OUTPUT_AXIS,	/* by gamepad axis */
+	GAMEPAD_TABLE_OUTPUT_BUTTON,	/* by gamepad button */
+	GAMEPAD_TABLE_COUNT
+};
+
+/* The bindings of index i are bindings[first[i]] .. bindings[first[i + 1] - 1], in mapping order */
+typedef struct GamepadBindingTable
+{
+	int num_indices;
+	int *first;
+	SDL_GamepadBinding **bindings;
+} GamepadBindingTable;
+
 /* The SDL gamepad structure */
 struct SDL_Gamepad
 {
@@ -66,10 +121,17 @@ struct SDL_Gamepad
 	GamepadMapping_t *mapping _guarded;
 	int num_bindings _guarded;
 	SDL_GamepadBinding *bindings _guarded;
+	GamepadBindingTable tables[GAMEPAD_TABLE_COUNT] _guarded;
 	SDL_GamepadBinding **last_match_axis _guarded;
 	Uint8 *last_hat_mask _guarded;
 	Uint64 guide_button_down _guarded;
 
+	/* Outputs as last sent, read without locking. The seqlock is odd while they change */
+	volatile Uint32 state_seq;
+	volatile Uint64 state_timestamp;
+	volatile Sint16 axes[SDL_GAMEPAD_AXIS_MAX];
+	volatile Uint8 buttons[SDL_GAMEPAD_BUTTON_MAX];
+
 	struct SDL_Gamepad *next _guarded; /* pointer to next gamepad we have allocated */
 };
 
@@ -90,6 +152,10 @@ SDL_COMPILE_TIME_ASSERT(map_StringForGamepadType, SDL_arraysize(map_StringForGam
 
 static SDL_JoystickGUID s_zeroGUID;
 static GamepadMapping_t *s_pSupportedGamepads SDL_GUARDED_BY(SDL_joystick_lock) = NULL;
+static GamepadMapping_t *s_pLastSupportedGamepad SDL_GUARDED_BY(SDL_joystick_lock) = NULL;
+static GamepadMapping_t **s_pMappingIndex SDL_GUARDED_BY(SDL_joystick_lock) = NULL;
+static int s_nMappingIndexSize SDL_GUARDED_BY(SDL_joystick_lock) = 0;
+static int s_nMappingIndexCount SDL_GUARDED_BY(SDL_joystick_lock) = 0;
 static GamepadMapping_t *s_pDefaultMapping SDL_GUARDED_BY(SDL_joystick_lock) = NULL;
 static GamepadMapping_t *s_pXInputMapping SDL_GUARDED_BY(SDL_joystick_lock) = NULL;
 static char gamepad_magic;
@@ -98,6 +164,9 @@ static void PushMappingChangeTracking(void) {};
 static void AddMappingChangeTracking(GamepadMapping_t *mapping) {};
 static void PopMappingChangeTracking(void) {};
 
+static GamepadMapping_t *SDL_PrivateAddMappingForGUID(SDL_JoystickGUID jGUID, const char *mappingString, SDL_bool *existing, SDL_GamepadMappingPriority priority);
+static GamepadMapping_t *SDL_PrivateAddBuiltinMapping(const GamepadDBEntry *entry);
+
 /*
  * convert a string to its enum equivalent
  */
@@ -132,14 +201,6 @@ const char *SDL_GetGamepadStringForType(SDL_GamepadType type)
 	return NULL;
 }
 
-static const char *map_StringForGamepadAxis[] = {
-	"leftx",
-	"lefty",
-	"rightx",
-	"righty",
-	"lefttrigger",
-	"righttrigger"
-};
 SDL_COMPILE_TIME_ASSERT(map_StringForGamepadAxis, SDL_arraysize(map_StringForGamepadAxis) == SDL_GAMEPAD_AXIS_MAX);
 
 /*
@@ -176,34 +237,6 @@ const char *SDL_GetGamepadStringForAxis(SDL_GamepadAxis axis)
 	return NULL;
 }
 
-static const char *map_StringForGamepadButton[] = {
-	"a",
-	"b",
-	"x",
-	"y",
-	"back",
-	"guide",
-	"start",
-	"leftstick",
-	"rightstick",
-	"leftshoulder",
-	"rightshoulder",
-	"dpup",
-	"dpdown",
-	"dpleft",
-	"dpright",
-	"misc1",
-	"paddle1",
-	"paddle2",
-	"paddle3",
-	"paddle4",
-	"touchpad",
-	"misc2",
-	"misc3",
-	"misc4",
-	"misc5",
-	"misc6"
-};
 SDL_COMPILE_TIME_ASSERT(map_StringForGamepadButton, SDL_arraysize(map_StringForGamepadButton) == SDL_GAMEPAD_BUTTON_MAX);
 
 /*
@@ -256,35 +289,139 @@ const char *SDL_GetGamepadStringForButton(SDL_GamepadButton button)
 }
 
 /*
- * given a gamepad button name and a joystick name update our mapping structure with it
+ * Gamepad axis and button names by element: axes first, then buttons. The
+ * generated s_GamepadElementSlots table places each in a slot of its own.
+ */
+#define SDL_GAMEPAD_ELEMENT_MAX	(SDL_GAMEPAD_AXIS_MAX + SDL_GAMEPAD_BUTTON_MAX)
+SDL_COMPILE_TIME_ASSERT(gamepad_elements, SDL_GAMEPAD_ELEMENTS == SDL_GAMEPAD_ELEMENT_MAX);
+
+static const char *SDL_PrivateGetGamepadElementName(int element)
+{
+	if (element < SDL_GAMEPAD_AXIS_MAX) {
+		return map_StringForGamepadAxis[element];
+	}
+	return map_StringForGamepadButton[element - SDL_GAMEPAD_AXIS_MAX];
+}
+
+/*
+ * Returns the element of a name, or -1 if it isn't an axis or button name
+ */
+static int SDL_PrivateGetGamepadElementFromName(const char *name, const char *name_end)
+{
+	const char *element_name;
+	int element;
+
+	element = s_GamepadElementSlots[SDL_GamepadElementHash(name, name_end, SDL_GAMEPAD_ELEMENT_SEED) & (SDL_GAMEPAD_ELEMENT_SLOTS - 1)] - 1;
+	if (element < 0) {
+		return -1;
+	}
+
+	/* Element names are lower case */
+	element_name = SDL_PrivateGetGamepadElementName(element);
+	for (; name < name_end; ++name) {
+		if (*name == ' ') {
+			continue;
+		}
+		if (SDL_tolower((unsigned char)*name) != *element_name) {
+			return -1;
+		}
+		++element_name;
+	}
+	return *element_name ? -1 : element;
+}
+
+/*
+ * Split the next element off a mapping string, without copying it. The input
+ * follows the last colon, for fields like hint:NAME:=1. Returns SDL_FALSE at
+ * the end of the string, element is -1 for names that aren't axes or buttons.
  */
-static SDL_bool SDL_PrivateParseGamepadElement(SDL_Gamepad *gamepad, const char *szGameButton, const char *szJoystickButton)
+static SDL_bool SDL_PrivateNextGamepadElement(const char **pchString, int *element, char *half_axis_output, const char **input, const char **input_end)
+{
+	const char *pos = *pchString;
+	const char *end, *name, *name_end;
+
+	if (!*pos) {
+		return SDL_FALSE;
+	}
+
+	end = SDL_strchr(pos, ',');
+	if (!end) {
+		end = pos + SDL_strlen(pos);
+	}
+	*pchString = *end ? end + 1 : end;
+
+	name_end = SDL_memchr(pos, ':', end - pos);
+	if (!name_end) {
+		name_end = end;
+	}
+	for (*input = end; *input > name_end && (*input)[-1] != ':'; --*input) {
+	}
+	*input_end = end;
+
+	name = pos;
+	while (name < name_end && *name == ' ') {
+		++name;
+	}
+	*half_axis_output = 0;
+	if (name < name_end && (*name == '+' || *name == '-')) {
+		*half_axis_output = *name++;
+	}
+
+	*element = SDL_PrivateGetGamepadElementFromName(name, name_end);
+	return SDL_TRUE;
+}
+
+/*
+ * Next character of an input, skipping spaces like everywhere in a mapping. 0 at its end.
+ */
+static char SDL_PrivatePeekGamepadInput(const char **input, const char *input_end)
+{
+	while (*input < input_end && **input == ' ') {
+		++*input;
+	}
+	return (*input < input_end) ? **input : '\0';
+}
+
+/*
+ * Read the decimal number at the start of an input
+ */
+static int SDL_PrivateParseGamepadInputNumber(const char **input, const char *input_end)
+{
+	int value = 0;
+
+	while (SDL_isdigit((unsigned char)SDL_PrivatePeekGamepadInput(input, input_end))) {
+		value = value * 10 + (*(*input)++ - '0');
+	}
+	return value;
+}
+
+/*
+ * given a gamepad element and a joystick input update our mapping structure with it,
+ * the bindings have room for it. The input is read in place.
+ */
+static SDL_bool SDL_PrivateParseGamepadElement(SDL_Gamepad *gamepad, int element, char half_axis_output, const char *input, const char *input_end, Uint64 *outputs)
 {
 	SDL_GamepadBinding bind;
 	SDL_GamepadButton button;
 	SDL_GamepadAxis axis;
-	SDL_bool invert_input = SDL_FALSE;
+	char input_type;
 	char half_axis_input = 0;
-	char half_axis_output = 0;
+	SDL_bool invert_input = SDL_FALSE;
+	Uint64 output;
 	int i;
-	SDL_GamepadBinding *new_bindings;
 	SDL_bool baxy_mapping = SDL_FALSE;
 
 	SDL_AssertJoysticksLocked();
 
 	SDL_zero(bind);
 
-	if (*szGameButton == '+' || *szGameButton == '-') {
-		half_axis_output = *szGameButton++;
-	}
 #if 0
 	if (SDL_strstr(gamepad->mapping->mapping, ",hint:SDL_GAMECONTROLLER_USE_BUTTON_LABELS:=1") != NULL) {
 		baxy_mapping = SDL_TRUE;
 	}
 #endif
-	axis = SDL_GetGamepadAxisFromString(szGameButton);
-	button = SDL_PrivateGetGamepadButtonFromString(szGameButton, baxy_mapping);
-	if (axis != SDL_GAMEPAD_AXIS_INVALID) {
+	if (element < SDL_GAMEPAD_AXIS_MAX) {
+		axis = (SDL_GamepadAxis)element;
 		bind.output_type = SDL_GAMEPAD_BINDTYPE_AXIS;
 		bind.output.axis.axis = axis;
 		if (axis == SDL_GAMEPAD_AXIS_LEFT_TRIGGER || axis == SDL_GAMEPAD_AXIS_RIGHT_TRIGGER) {
@@ -302,23 +439,43 @@ static SDL_bool SDL_PrivateParseGamepadElement(SDL_Gamepad *gamepad, const char
 				bind.output.axis.axis_max = SDL_JOYSTICK_AXIS_MAX;
 			}
 		}
-	} else if (button != SDL_GAMEPAD_BUTTON_INVALID) {
+		output = 1ULL << axis;
+	} else {
+		button = (SDL_GamepadButton)(element - SDL_GAMEPAD_AXIS_MAX);
+		if (baxy_mapping) {
+			button = SDL_PrivateGetGamepadButtonFromString(map_StringForGamepadButton[button], SDL_TRUE);
+		}
 		bind.output_type = SDL_GAMEPAD_BINDTYPE_BUTTON;
 		bind.output.button = button;
-	} else {
+		output = 1ULL << (SDL_GAMEPAD_AXIS_MAX + button);
+	}
+
+	input_type = SDL_PrivatePeekGamepadInput(&input, input_end);
+	if (input_type == '+' || input_type == '-') {
+		half_axis_input = input_type;
+		++input;
+		input_type = SDL_PrivatePeekGamepadInput(&input, input_end);
+	}
+	if (input_type == '\0') {
 		return SDL_FALSE;
 	}
+	++input;
 
-	if (*szJoystickButton == '+' || *szJoystickButton == '-') {
-		half_axis_input = *szJoystickButton++;
+	/* The prefix skipped the leading spaces, look for the suffix before the trailing ones */
+	while (input_end > input && input_end[-1] == ' ') {
+		--input_end;
 	}
-	if (szJoystickButton[SDL_strlen(szJoystickButton) - 1] == '~') {
+	if (input_end > input && input_end[-1] == '~') {
 		invert_input = SDL_TRUE;
 	}
 
-	if (szJoystickButton[0] == 'a' && SDL_isdigit((unsigned char)szJoystickButton[1])) {
+	if (!SDL_isdigit((unsigned char)SDL_PrivatePeekGamepadInput(&input, input_end))) {
+		return SDL_FALSE;
+	}
+
+	if (input_type == 'a') {
 		bind.input_type = SDL_GAMEPAD_BINDTYPE_AXIS;
-		bind.input.axis.axis = SDL_atoi(&szJoystickButton[1]);
+		bind.input.axis.axis = SDL_PrivateParseGamepadInputNumber(&input, input_end);
 		if (half_axis_input == '+') {
 			bind.input.axis.axis_min = 0;
 			bind.input.axis.axis_max = SDL_JOYSTICK_AXIS_MAX;
@@ -334,88 +491,149 @@ static SDL_bool SDL_PrivateParseGamepadElement(SDL_Gamepad *gamepad, const char
 			bind.input.axis.axis_min = bind.input.axis.axis_max;
 			bind.input.axis.axis_max = tmp;
 		}
-	} else if (szJoystickButton[0] == 'b' && SDL_isdigit((unsigned char)szJoystickButton[1])) {
+	} else if (input_type == 'b') {
 		bind.input_type = SDL_GAMEPAD_BINDTYPE_BUTTON;
-		bind.input.button = SDL_atoi(&szJoystickButton[1]);
-	} else if (szJoystickButton[0] == 'h' && SDL_isdigit((unsigned char)szJoystickButton[1]) &&
-			   szJoystickButton[2] == '.' && SDL_isdigit((unsigned char)szJoystickButton[3])) {
-		int hat = SDL_atoi(&szJoystickButton[1]);
-		int mask = SDL_atoi(&szJoystickButton[3]);
+		bind.input.button = SDL_PrivateParseGamepadInputNumber(&input, input_end);
+	} else if (input_type == 'h') {
+		int hat = SDL_PrivateParseGamepadInputNumber(&input, input_end);
+		if (SDL_PrivatePeekGamepadInput(&input, input_end) != '.') {
+			return SDL_FALSE;
+		}
+		++input;
+		if (!SDL_isdigit((unsigned char)SDL_PrivatePeekGamepadInput(&input, input_end))) {
+			return SDL_FALSE;
+		}
 		bind.input_type = SDL_GAMEPAD_BINDTYPE_HAT;
 		bind.input.hat.hat = hat;
-		bind.input.hat.hat_mask = mask;
+		bind.input.hat.hat_mask = SDL_PrivateParseGamepadInputNumber(&input, input_end);
 	} else {
 		return SDL_FALSE;
 	}
 
-	for (i = 0; i < gamepad->num_bindings; ++i) {
-		if (SDL_memcmp(&gamepad->bindings[i], &bind, sizeof(bind)) == 0) {
-			/* We already have this binding, could be different face button names? */
-			return SDL_TRUE;
+	/* A duplicate has the same output, only search when the output was seen */
+	if (*outputs & output) {
+		for (i = 0; i < gamepad->num_bindings; ++i) {
+			if (SDL_memcmp(&gamepad->bindings[i], &bind, sizeof(bind)) == 0) {
+				/* We already have this binding, could be different face button names? */
+				return SDL_TRUE;
+			}
 		}
 	}
+	*outputs |= output;
+
+	gamepad->bindings[gamepad->num_bindings++] = bind;
+	return SDL_TRUE;
+}
 
-	++gamepad->num_bindings;
-	new_bindings = (SDL_GamepadBinding *)SDL_realloc(gamepad->bindings, gamepad->num_bindings * sizeof(*gamepad->bindings));
+/*
+ * given a gamepad mapping string update our mapping object
+ *
+ * The string is read in place twice: once to count the elements naming an
+ * axis or button, once to fill the bindings sized for them. Elements with an
+ * invalid or duplicate input are only found by the second pass, the array is
+ * shrunk to the bindings kept then.
+ */
+static int SDL_PrivateParseGamepadConfigString(SDL_Gamepad *gamepad, const char *pchString)
+{
+	SDL_GamepadBinding *new_bindings;
+	const char *pchPos;
+	const char *input, *input_end;
+	char half_axis_output;
+	Uint64 outputs = 0;
+	int element, count = 0, num_allocated;
+
+	for (pchPos = pchString; SDL_PrivateNextGamepadElement(&pchPos, &element, &half_axis_output, &input, &input_end);) {
+		if (element >= 0) {
+			++count;
+		}
+	}
+	if (count == 0) {
+		return 0;
+	}
+
+	num_allocated = gamepad->num_bindings + count;
+	new_bindings = (SDL_GamepadBinding *)SDL_realloc(gamepad->bindings, num_allocated * sizeof(*gamepad->bindings));
 	if (!new_bindings) {
 		SDL_free(gamepad->bindings);
 		gamepad->num_bindings = 0;
 		gamepad->bindings = NULL;
-		return SDL_FALSE;
+		return -1;
 	}
 	gamepad->bindings = new_bindings;
-	gamepad->bindings[gamepad->num_bindings - 1] = bind;
-	return SDL_TRUE;
+
+	for (pchPos = pchString; SDL_PrivateNextGamepadElement(&pchPos, &element, &half_axis_output, &input, &input_end);) {
+		if (element >= 0) {
+			SDL_PrivateParseGamepadElement(gamepad, element, half_axis_output, input, input_end, &outputs);
+		}
+	}
+
+	if (gamepad->num_bindings == 0) {
+		SDL_free(gamepad->bindings);
+		gamepad->bindings = NULL;
+	} else if (gamepad->num_bindings < num_allocated) {
+		/* Shrinking in place, keep the larger array if that fails */
+		new_bindings = (SDL_GamepadBinding *)SDL_realloc(gamepad->bindings, gamepad->num_bindings * sizeof(*gamepad->bindings));
+		if (new_bindings) {
+			gamepad->bindings = new_bindings;
+		}
+	}
+	return 0;
 }
 
 /*
- * given a gamepad mapping string update our mapping object
+ * The mappings list is indexed by GUID without the CRC, with the hash of the
+ * compiled database. Buckets keep the list order and the index grows with
+ * the list, so a lookup doesn't depend on the number of mappings.
  */
-static int SDL_PrivateParseGamepadConfigString(SDL_Gamepad *gamepad, const char *pchString)
+static GamepadMapping_t **SDL_PrivateGetMappingIndexBucket(const SDL_JoystickGUID *guid)
 {
-	char szGameButton[20];
-	char szJoystickButton[20];
-	SDL_bool bGameButton = SDL_TRUE;
-	int i = 0;
-	const char *pchPos = pchString;
-
-	SDL_zeroa(szGameButton);
-	SDL_zeroa(szJoystickButton);
-
-	while (pchPos && *pchPos) {
-		if (*pchPos == ':') {
-			i = 0;
-			bGameButton = SDL_FALSE;
-		} else if (*pchPos == ' ') {
-
-		} else if (*pchPos == ',') {
-			i = 0;
-			bGameButton = SDL_TRUE;
-			SDL_PrivateParseGamepadElement(gamepad, szGameButton, szJoystickButton);
-			SDL_zeroa(szGameButton);
-			SDL_zeroa(szJoystickButton);
-
-		} else if (bGameButton) {
-			if (i >= sizeof(szGameButton)) {
-				szGameButton[sizeof(szGameButton) - 1] = '\0';
-				return SDL_SetError("Button name too large: %s", szGameButton);
-			}
-			szGameButton[i] = *pchPos;
-			i++;
-		} else {
-			if (i >= sizeof(szJoystickButton)) {
-				szJoystickButton[sizeof(szJoystickButton) - 1] = '\0';
-				return SDL_SetError("Joystick button name too large: %s", szJoystickButton);
-			}
-			szJoystickButton[i] = *pchPos;
-			i++;
-		}
-		pchPos++;
+	return &s_pMappingIndex[SDL_GamepadDBHash(guid->data, 0) & (s_nMappingIndexSize - 1)];
+}
+
+static void SDL_PrivateIndexGamepadMapping(GamepadMapping_t *mapping)
+{
+	GamepadMapping_t **bucket;
+
+	mapping->hash_next = NULL;
+
+	/* Mappings without a GUID are never matched */
+	if (SDL_memcmp(&mapping->guid, &s_zeroGUID, sizeof(mapping->guid)) == 0) {
+		return;
+	}
+
+	for (bucket = SDL_PrivateGetMappingIndexBucket(&mapping->guid); *bucket; bucket = &(*bucket)->hash_next) {
+		/* continue; */
+	}
+	*bucket = mapping;
+	s_nMappingIndexCount++;
+}
+
+/*
+ * Makes room in the index for one more mapping
+ */
+static int SDL_PrivateGrowMappingIndex(void)
+{
+	GamepadMapping_t **index;
+	GamepadMapping_t *mapping;
+	int size;
+
+	if (s_nMappingIndexCount < s_nMappingIndexSize) {
+		return 0;
+	}
+
+	size = s_nMappingIndexSize ? s_nMappingIndexSize * 2 : 64;
+	index = (GamepadMapping_t **)SDL_calloc(size, sizeof(*index));
+	if (!index) {
+		return -1;
 	}
 
-	/* No more values if the string was terminated by a comma. Don't report an error. */
-	if (szGameButton[0] != '\0' || szJoystickButton[0] != '\0') {
-		SDL_PrivateParseGamepadElement(gamepad, szGameButton, szJoystickButton);
+	SDL_free(s_pMappingIndex);
+	s_pMappingIndex = index;
+	s_nMappingIndexSize = size;
+	s_nMappingIndexCount = 0;
+
+	for (mapping = s_pSupportedGamepads; mapping; mapping = mapping->next) {
+		SDL_PrivateIndexGamepadMapping(mapping);
 	}
 	return 0;
 }
@@ -441,12 +659,27 @@ static GamepadMapping_t *SDL_PrivateMatchGamepadMappingForGUID(SDL_JoystickGUID
 		SDL_SetJoystickGUIDVersion(&guid, 0);
 	}
 
-	{
+	if (g_log_settings & LOG_SDL_GAMEPAD_TRACE) {
 		char buff[100];
 		SDL_GUIDToString(guid, buff, sizeof(buff));
 		LOG(LOG_SDL_GAMEPAD_TRACE, "Search mapping for GUID: %s\n", buff);
 	}
 
+	if (match_version) {
+		if (!s_nMappingIndexSize) {
+			return NULL;
+		}
+
+		for (mapping = *SDL_PrivateGetMappingIndexBucket(&guid); mapping; mapping = mapping->hash_next) {
+			if (SDL_memcmp(&guid, &mapping->guid, sizeof(guid)) == 0 &&
+				(!match_crc || crc == mapping->crc)) {
+				return mapping;
+			}
+		}
+		return NULL;
+	}
+
+	/* The index includes the version, scan the list when ignoring it */
 	for (mapping = s_pSupportedGamepads; mapping; mapping = mapping->next) {
 		SDL_JoystickGUID mapping_guid;
 
@@ -459,30 +692,50 @@ static GamepadMapping_t *SDL_PrivateMatchGamepadMappingForGUID(SDL_JoystickGUID
 			SDL_SetJoystickGUIDVersion(&mapping_guid, 0);
 		}
 
-		if (SDL_memcmp(&guid, &mapping_guid, sizeof(guid)) == 0) {
-			Uint16 mapping_crc = 0;
-
-			if (match_crc) {
-				const char *crc_string = SDL_strstr(mapping->mapping, SDL_GAMEPAD_CRC_FIELD);
-				if (crc_string) {
-					mapping_crc = (Uint16)SDL_strtol(crc_string + SDL_GAMEPAD_CRC_FIELD_SIZE, NULL, 16);
-				}
-			}
-			if (crc == mapping_crc) {
-				return mapping;
-			}
+		if (SDL_memcmp(&guid, &mapping_guid, sizeof(guid)) == 0 &&
+			(!match_crc || crc == mapping->crc)) {
+			return mapping;
 		}
 	}
 
 	return NULL;
 }
 
+/*
+ * Helper function to find a built-in mapping for the specified GUID
+ */
+static const GamepadDBEntry *SDL_PrivateFindGamepadDBEntry(SDL_JoystickGUID guid)
+{
+	const GamepadDBEntry *entry;
+	unsigned int hash;
+	Uint16 slot;
+
+	/* Like the mappings list, the database ignores the CRC */
+	SDL_SetJoystickGUIDCRC(&guid, 0);
+
+	hash = SDL_GamepadDBHash(guid.data, 0);
+	hash = SDL_GamepadDBHash(guid.data, s_GamepadDBSeeds[hash & (SDL_GAMEPAD_DB_BUCKETS - 1)]);
+	slot = s_GamepadDBSlots[hash & (SDL_GAMEPAD_DB_SLOTS - 1)];
+	if (!slot) {
+		return NULL;
+	}
+
+	/* Every GUID lands in some slot, check it is the one stored there */
+	entry = &s_GamepadDB[slot - 1];
+	if (SDL_memcmp(entry->guid, guid.data, 2) != 0 ||
+		SDL_memcmp(entry->guid + 4, guid.data + 4, sizeof(entry->guid) - 4) != 0) {
+		return NULL;
+	}
+	return entry;
+}
+
 /*
  * Helper function to scan the mappings database for a gamepad with the specified GUID
  */
 static GamepadMapping_t *SDL_PrivateGetGamepadMappingForGUID(SDL_JoystickGUID guid, SDL_bool adding_mapping)
 {
 	GamepadMapping_t *mapping;
+	const GamepadDBEntry *entry;
 	Uint16 vendor, product, crc;
 
 	SDL_GetJoystickGUIDInfo(guid, &vendor, &product, NULL, &crc);
@@ -500,6 +753,21 @@ static GamepadMapping_t *SDL_PrivateGetGamepadMappingForGUID(SDL_JoystickGUID gu
 		return mapping;
 	}
 
+	/*
+	 * Then for a built-in mapping, added to the list on first use. Adding it
+	 * replaces any mapping with the same GUID, so the database holds one
+	 * mapping per GUID and the list had none for this one.
+	 */
+	if (!adding_mapping) {
+		entry = SDL_PrivateFindGamepadDBEntry(guid);
+		if (entry) {
+			mapping = SDL_PrivateAddBuiltinMapping(entry);
+			if (mapping) {
+				return mapping;
+			}
+		}
+	}
+
 #if 0
 	if (adding_mapping) {
 		/* We didn't find an existing mapping */
@@ -645,6 +913,279 @@ SDL_GamepadType SDL_GetRealGamepadInstanceType(SDL_JoystickID instance_id)
 	return type;
 }
 #endif
+/*
+ * Get the index a binding is filed under in a lookup table, or -1 if it doesn't belong there
+ */
+static int SDL_PrivateGetBindingTableIndex(const SDL_GamepadBinding *binding, int table)
+{
+	switch (table) {
+	case GAMEPAD_TABLE_AXIS:
+		return binding->input_type == SDL_GAMEPAD_BINDTYPE_AXIS ? binding->input.axis.axis : -1;
+	case GAMEPAD_TABLE_BUTTON:
+		return binding->input_type == SDL_GAMEPAD_BINDTYPE_BUTTON ? binding->input.button : -1;
+	case GAMEPAD_TABLE_HAT:
+		return binding->input_type == SDL_GAMEPAD_BINDTYPE_HAT ? binding->input.hat.hat : -1;
+	case GAMEPAD_TABLE_OUTPUT_AXIS:
+		return binding->output_type == SDL_GAMEPAD_BINDTYPE_AXIS ? (int)binding->output.axis.axis : -1;
+	case GAMEPAD_TABLE_OUTPUT_BUTTON:
+		return binding->output_type == SDL_GAMEPAD_BINDTYPE_BUTTON ? (int)binding->output.button : -1;
+	default:
+		return -1;
+	}
+}
+
+/*
+ * Group the bindings by input and by output, so events and queries only visit their own bindings
+ */
+static void SDL_PrivateBuildBindingTables(SDL_Gamepad *gamepad)
+{
+	int t, i, index, num_bindings;
+
+	SDL_AssertJoysticksLocked();
+
+	for (t = 0; t < GAMEPAD_TABLE_COUNT; ++t) {
+		GamepadBindingTable *table = &gamepad->tables[t];
+
+		SDL_free(table->bindings);
+		SDL_zerop(table);
+
+		num_bindings = 0;
+		for (i = 0; i < gamepad->num_bindings; ++i) {
+			index = SDL_PrivateGetBindingTableIndex(&gamepad->bindings[i], t);
+			if (index >= 0) {
+				if (index >= table->num_indices) {
+					table->num_indices = index + 1;
+				}
+				++num_bindings;
+			}
+		}
+		if (num_bindings == 0) {
+			continue;
+		}
+
+		/* The offsets live in the same block, after the binding pointers */
+		table->bindings = (SDL_GamepadBinding **)SDL_malloc(num_bindings * sizeof(*table->bindings) +
+								   (table->num_indices + 1) * sizeof(*table->first));
+		if (!table->bindings) {
+			table->num_indices = 0;
+			continue;
+		}
+		table->first = (int *)(table->bindings + num_bindings);
+		SDL_memset(table->first, 0, (table->num_indices + 1) * sizeof(*table->first));
+
+		/* Counting sort, stable so the first matching binding still wins */
+		for (i = 0; i < gamepad->num_bindings; ++i) {
+			index = SDL_PrivateGetBindingTableIndex(&gamepad->bindings[i], t);
+			if (index >= 0) {
+				++table->first[index + 1];
+			}
+		}
+		for (i = 0; i < table->num_indices; ++i) {
+			table->first[i + 1] += table->first[i];
+		}
+		for (i = 0; i < gamepad->num_bindings; ++i) {
+			index = SDL_PrivateGetBindingTableIndex(&gamepad->bindings[i], t);
+			if (index >= 0) {
+				table->bindings[table->first[index]++] = &gamepad->bindings[i];
+			}
+		}
+		/* Filling moved every offset to the start of the next index */
+		for (i = table->num_indices; i > 0; --i) {
+			table->first[i] = table->first[i - 1];
+		}
+		table->first[0] = 0;
+	}
+}
+
+/*
+ * Get the bindings filed under an index of a lookup table, returns their number
+ */
+static int SDL_PrivateGetBindings(SDL_Gamepad *gamepad, int table, int index, SDL_GamepadBinding ***bindings)
+{
+	const GamepadBindingTable *t = &gamepad->tables[table];
+
+	if (index < 0 || index >= t->num_indices) {
+		return 0;
+	}
+
+	*bindings = &t->bindings[t->first[index]];
+	return t->first[index + 1] - t->first[index];
+}
+
+/*
+ * Parse the bindings of a mapping into the gamepad, only once per mapping string
+ */
+static void SDL_PrivateLoadBindings(SDL_Gamepad *gamepad, GamepadMapping_t *pGamepadMapping)
+{
+	SDL_GamepadBinding *bindings;
+
+	if (pGamepadMapping->bindings) {
+		bindings = (SDL_GamepadBinding *)SDL_realloc(gamepad->bindings, pGamepadMapping->num_bindings * sizeof(*bindings));
+		if (bindings) {
+			SDL_memcpy(bindings, pGamepadMapping->bindings, pGamepadMapping->num_bindings * sizeof(*bindings));
+			gamepad->bindings = bindings;
+			gamepad->num_bindings = pGamepadMapping->num_bindings;
+			return;
+		}
+	}
+
+	SDL_PrivateParseGamepadConfigString(gamepad, pGamepadMapping->mapping);
+
+	/* Keep a copy for the next gamepad with this mapping */
+	if (!pGamepadMapping->bindings && gamepad->num_bindings > 0) {
+		bindings = (SDL_GamepadBinding *)SDL_malloc(gamepad->num_bindings * sizeof(*bindings));
+		if (bindings) {
+			SDL_memcpy(bindings, gamepad->bindings, gamepad->num_bindings * sizeof(*bindings));
+			pGamepadMapping->bindings = bindings;
+			pGamepadMapping->num_bindings = gamepad->num_bindings;
+		}
+	}
+}
+
+/*
+ * Update the cached outputs, they are only written with the joystick lock held
+ */
+static void SDL_PrivateBeginStateUpdate(SDL_Gamepad *gamepad, Uint64 timestamp)
+{
+	++gamepad->state_seq;
+	__sync_synchronize();
+	gamepad->state_timestamp = timestamp;
+}
+
+static void SDL_PrivateEndStateUpdate(SDL_Gamepad *gamepad)
+{
+	__sync_synchronize();
+	++gamepad->state_seq;
+}
+
+/*
+ * Find the binding an axis value falls into
+ */
+static SDL_GamepadBinding *SDL_PrivateMatchAxisBinding(SDL_Gamepad *gamepad, int axis, int value)
+{
+	int i, num_bindings;
+	SDL_GamepadBinding **bindings;
+
+	num_bindings = SDL_PrivateGetBindings(gamepad, GAMEPAD_TABLE_AXIS, axis, &bindings);
+	for (i = 0; i < num_bindings; ++i) {
+		SDL_GamepadBinding *binding = bindings[i];
+		if (binding->input.axis.axis_min < binding->input.axis.axis_max) {
+			if (value >= binding->input.axis.axis_min &&
+				value <= binding->input.axis.axis_max) {
+				return binding;
+			}
+		} else {
+			if (value >= binding->input.axis.axis_max &&
+				value <= binding->input.axis.axis_min) {
+				return binding;
+			}
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Output of a binding for an input value: an axis value or a button state.
+ * The value of a hat input is the joystick hat masked with the binding's direction.
+ */
+static int SDL_PrivateGetBindingOutput(SDL_GamepadBinding *binding, int value)
+{
+	if (binding->input_type == SDL_GAMEPAD_BINDTYPE_AXIS) {
+		if (binding->output_type == SDL_GAMEPAD_BINDTYPE_AXIS) {
+			if (binding->input.axis.axis_min != binding->output.axis.axis_min || binding->input.axis.axis_max != binding->output.axis.axis_max) {
+				float normalized_value = (float)(value - binding->input.axis.axis_min) / (binding->input.axis.axis_max - binding->input.axis.axis_min);
+				value = binding->output.axis.axis_min + (int)(normalized_value * (binding->output.axis.axis_max - binding->output.axis.axis_min));
+			}
+			return value;
+		} else {
+			int threshold = binding->input.axis.axis_min + (binding->input.axis.axis_max - binding->input.axis.axis_min) / 2;
+			if (binding->input.axis.axis_max < binding->input.axis.axis_min) {
+				return (value <= threshold) ? SDL_PRESSED : SDL_RELEASED;
+			} else {
+				return (value >= threshold) ? SDL_PRESSED : SDL_RELEASED;
+			}
+		}
+	}
+
+	if (binding->output_type == SDL_GAMEPAD_BINDTYPE_AXIS) {
+		if (value) {
+			return binding->output.axis.axis_max;
+		}
+		/* A released button goes back to the start of its range, a released hat to the center */
+		return (binding->input_type == SDL_GAMEPAD_BINDTYPE_BUTTON) ? binding->output.axis.axis_min : 0;
+	}
+	return value ? SDL_PRESSED : SDL_RELEASED;
+}
+
+/*
+ * Store the output of a binding in the cached state without sending an event
+ */
+static void SDL_PrivateSetInitialOutput(SDL_Gamepad *gamepad, SDL_GamepadBinding *binding, int value)
+{
+	value = SDL_PrivateGetBindingOutput(binding, value);
+
+	if (binding->output_type == SDL_GAMEPAD_BINDTYPE_AXIS) {
+		if (binding->output.axis.axis > SDL_GAMEPAD_AXIS_INVALID && binding->output.axis.axis < SDL_GAMEPAD_AXIS_MAX) {
+			gamepad->axes[binding->output.axis.axis] = (Sint16)value;
+		}
+	} else {
+		if (binding->output.button > SDL_GAMEPAD_BUTTON_INVALID && binding->output.button < SDL_GAMEPAD_BUTTON_MAX) {
+			gamepad->buttons[binding->output.button] = (Uint8)value;
+		}
+	}
+}
+
+/*
+ * Start the cached outputs and the last matches from the current joystick state,
+ * so the getters are right before any input changes
+ */
+static void SDL_PrivateInitGamepadState(SDL_Gamepad *gamepad)
+{
+	SDL_Joystick *joystick = gamepad->joystick;
+	SDL_GamepadBinding **bindings;
+	SDL_GamepadBinding *match;
+	int i, j, num_bindings;
+
+	SDL_AssertJoysticksLocked();
+
+	SDL_PrivateBeginStateUpdate(gamepad, SDL_GetTicksNS());
+
+	SDL_memset((void *)gamepad->axes, 0, sizeof(gamepad->axes));
+	SDL_memset((void *)gamepad->buttons, 0, sizeof(gamepad->buttons));
+
+	for (i = 0; i < joystick->naxes; ++i) {
+		match = SDL_PrivateMatchAxisBinding(gamepad, i, joystick->axes[i].value);
+		if (match) {
+			SDL_PrivateSetInitialOutput(gamepad, match, joystick->axes[i].value);
+		}
+		gamepad->last_match_axis[i] = match;
+	}
+
+	/*
+	 * Only pressed buttons and hat directions are set, so a released one
+	 * can't clear an output another one shares. Only the first binding of a
+	 * button is used.
+	 */
+	for (i = 0; i < joystick->nbuttons; ++i) {
+		if (joystick->buttons[i] &&
+			SDL_PrivateGetBindings(gamepad, GAMEPAD_TABLE_BUTTON, i, &bindings) > 0) {
+			SDL_PrivateSetInitialOutput(gamepad, bindings[0], joystick->buttons[i]);
+		}
+	}
+
+	for (i = 0; i < joystick->nhats; ++i) {
+		num_bindings = SDL_PrivateGetBindings(gamepad, GAMEPAD_TABLE_HAT, i, &bindings);
+		for (j = 0; j < num_bindings; ++j) {
+			if (joystick->hats[i] & bindings[j]->input.hat.hat_mask) {
+				SDL_PrivateSetInitialOutput(gamepad, bindings[j], joystick->hats[i] & bindings[j]->input.hat.hat_mask);
+			}
+		}
+		gamepad->last_hat_mask[i] = joystick->hats[i];
+	}
+
+	SDL_PrivateEndStateUpdate(gamepad);
+}
+
 /*
  * Make a new button mapping struct
  */
@@ -664,7 +1205,8 @@ static void SDL_PrivateLoadButtonMapping(SDL_Gamepad *gamepad, GamepadMapping_t
 	SDL_UpdateGamepadType(gamepad);
 	SDL_UpdateGamepadFaceStyle(gamepad);
 #endif
-	SDL_PrivateParseGamepadConfigString(gamepad, pGamepadMapping->mapping);
+	SDL_PrivateLoadBindings(gamepad, pGamepadMapping);
+	SDL_PrivateBuildBindingTables(gamepad);
 
 	/* Set the zero point for triggers */
 	for (i = 0; i < gamepad->num_bindings; ++i) {
@@ -679,6 +1221,8 @@ static void SDL_PrivateLoadButtonMapping(SDL_Gamepad *gamepad, GamepadMapping_t
 			}
 		}
 	}
+
+	SDL_PrivateInitGamepadState(gamepad);
 }
 
 /*
@@ -869,6 +1413,21 @@ static char *SDL_PrivateGetGamepadMappingFromMappingString(const char *pMapping)
 	return result;
 }
 
+/*
+ * Add a new mapping at the end of the list
+ */
+static void SDL_PrivateLinkGamepadMapping(GamepadMapping_t *pGamepadMapping)
+{
+	pGamepadMapping->next = NULL;
+	if (s_pLastSupportedGamepad) {
+		s_pLastSupportedGamepad->next = pGamepadMapping;
+	} else {
+		s_pSupportedGamepads = pGamepadMapping;
+	}
+	s_pLastSupportedGamepad = pGamepadMapping;
+	SDL_PrivateIndexGamepadMapping(pGamepadMapping);
+}
+
 /*
  * Helper function to add a mapping for a guid
  */
@@ -945,8 +1504,15 @@ static GamepadMapping_t *SDL_PrivateAddMappingForGUID(SDL_JoystickGUID jGUID, co
 			/* Update existing mapping */
 			SDL_free(pGamepadMapping->name);
 			pGamepadMapping->name = pchName;
-			SDL_free(pGamepadMapping->mapping);
+			if (!pGamepadMapping->mapping_is_static) {
+				SDL_free(pGamepadMapping->mapping);
+			}
 			pGamepadMapping->mapping = pchMapping;
+			pGamepadMapping->mapping_is_static = SDL_FALSE;
+			pGamepadMapping->crc = crc;
+			SDL_free(pGamepadMapping->bindings);
+			pGamepadMapping->bindings = NULL;
+			pGamepadMapping->num_bindings = 0;
 			pGamepadMapping->priority = priority;
 		} else {
 			SDL_free(pchName);
@@ -959,7 +1525,11 @@ static GamepadMapping_t *SDL_PrivateAddMappingForGUID(SDL_JoystickGUID jGUID, co
 		AddMappingChangeTracking(pGamepadMapping);
 
 	} else {
-		pGamepadMapping = (GamepadMapping_t *)SDL_malloc(sizeof(*pGamepadMapping));
+		if (SDL_PrivateGrowMappingIndex() == 0) {
+			pGamepadMapping = (GamepadMapping_t *)SDL_malloc(sizeof(*pGamepadMapping));
+		} else {
+			pGamepadMapping = NULL;
+		}
 		if (!pGamepadMapping) {
 
 			PopMappingChangeTracking();
@@ -975,22 +1545,12 @@ static GamepadMapping_t *SDL_PrivateAddMappingForGUID(SDL_JoystickGUID jGUID, co
 		pGamepadMapping->guid = jGUID;
 		pGamepadMapping->name = pchName;
 		pGamepadMapping->mapping = pchMapping;
-		pGamepadMapping->next = NULL;
+		pGamepadMapping->mapping_is_static = SDL_FALSE;
+		pGamepadMapping->crc = crc;
+		pGamepadMapping->num_bindings = 0;
+		pGamepadMapping->bindings = NULL;
 		pGamepadMapping->priority = priority;
-
-		if (s_pSupportedGamepads) {
-			/* Add the mapping to the end of the list */
-			GamepadMapping_t *pCurrMapping, *pPrevMapping;
-
-			for (pPrevMapping = s_pSupportedGamepads, pCurrMapping = pPrevMapping->next;
-				 pCurrMapping;
-				 pPrevMapping = pCurrMapping, pCurrMapping = pCurrMapping->next) {
-				/* continue; */
-			}
-			pPrevMapping->next = pGamepadMapping;
-		} else {
-			s_pSupportedGamepads = pGamepadMapping;
-		}
+		SDL_PrivateLinkGamepadMapping(pGamepadMapping);
 		if (existing) {
 			*existing = SDL_FALSE;
 		}
@@ -1001,6 +1561,73 @@ static GamepadMapping_t *SDL_PrivateAddMappingForGUID(SDL_JoystickGUID jGUID, co
 	return pGamepadMapping;
 }
 
+/*
+ * Add a mapping of the compiled database. The list doesn't have its GUID, and
+ * the mapping text is used in place instead of being copied.
+ */
+static GamepadMapping_t *SDL_PrivateAddBuiltinMapping(const GamepadDBEntry *entry)
+{
+	const char *mappingString = s_GamepadMappings[entry->index];
+	const char *pchMapping;
+	const char *crc_string;
+	char *pchName;
+	GamepadMapping_t *pGamepadMapping;
+	SDL_JoystickGUID jGUID;
+	size_t length;
+	Uint16 crc;
+
+	SDL_AssertJoysticksLocked();
+
+	SDL_memcpy(jGUID.data, entry->guid, sizeof(jGUID.data));
+	SDL_GetJoystickGUIDInfo(jGUID, NULL, NULL, NULL, &crc);
+
+	/* Hashed mappings always have a name, the mapping follows it */
+	pchMapping = SDL_strchr(SDL_strchr(mappingString, ',') + 1, ',');
+	while (SDL_isspace(pchMapping[1])) {
+		++pchMapping;
+	}
+	++pchMapping;
+	length = SDL_strlen(pchMapping);
+
+	/* A CRC to add to the mapping, or whitespace to trim, need a copy */
+	if (crc || (length > 0 && SDL_isspace(pchMapping[length - 1]))) {
+		return SDL_PrivateAddMappingForGUID(jGUID, mappingString, NULL, SDL_GAMEPAD_MAPPING_PRIORITY_DEFAULT);
+	}
+
+	pchName = SDL_PrivateGetGamepadNameFromMappingString(mappingString);
+	if (!pchName) {
+		return NULL;
+	}
+
+	if (SDL_PrivateGrowMappingIndex() < 0) {
+		SDL_free(pchName);
+		return NULL;
+	}
+
+	pGamepadMapping = (GamepadMapping_t *)SDL_malloc(sizeof(*pGamepadMapping));
+	if (!pGamepadMapping) {
+		SDL_free(pchName);
+		return NULL;
+	}
+
+	crc_string = SDL_strstr(pchMapping, SDL_GAMEPAD_CRC_FIELD);
+	if (crc_string) {
+		crc = (Uint16)SDL_strtol(crc_string + SDL_GAMEPAD_CRC_FIELD_SIZE, NULL, 16);
+	}
+
+	pGamepadMapping->guid = jGUID;
+	pGamepadMapping->name = pchName;
+	pGamepadMapping->mapping = (char *)pchMapping;
+	pGamepadMapping->mapping_is_static = SDL_TRUE;
+	pGamepadMapping->crc = crc;
+	pGamepadMapping->num_bindings = 0;
+	pGamepadMapping->bindings = NULL;
+	pGamepadMapping->priority = SDL_GAMEPAD_MAPPING_PRIORITY_DEFAULT;
+	SDL_PrivateLinkGamepadMapping(pGamepadMapping);
+
+	return pGamepadMapping;
+}
+
 /*
  * Add or update an entry into the Mappings Database with a priority
  */
@@ -1152,24 +1779,168 @@ int SDL_AddGamepadMapping(const char *mapping)
 }
 
 /*
- * Event filter to transform joystick events into appropriate gamepad ones
+ * Check the platform field of a database line, lines without one are skipped
+ */
+static SDL_bool SDL_PrivateIsMappingForPlatform(const char *line, const char *line_end)
+{
+	const size_t field_len = SDL_GAMEPAD_PLATFORM_FIELD_SIZE;
+	const size_t platform_len = SDL_strlen(SDL_GAMEPAD_MAPPING_PLATFORM);
+	const char *pos = line;
+
+	while (line_end - pos >= (ptrdiff_t)field_len) {
+		pos = SDL_memchr(pos, SDL_GAMEPAD_PLATFORM_FIELD[0], line_end - pos);
+		if (!pos || line_end - pos < (ptrdiff_t)field_len) {
+			break;
+		}
+		if (SDL_memcmp(pos, SDL_GAMEPAD_PLATFORM_FIELD, field_len) != 0) {
+			++pos;
+			continue;
+		}
+
+		pos += field_len;
+		return (line_end - pos >= (ptrdiff_t)platform_len &&
+				SDL_strncasecmp(pos, SDL_GAMEPAD_MAPPING_PLATFORM, platform_len) == 0 &&
+				(pos + platform_len == line_end || pos[platform_len] == ',')) ? SDL_TRUE : SDL_FALSE;
+	}
+	return SDL_FALSE;
+}
+
+/*
+ * Check that the GUID of a database line can be one SDL_CreateJoystickGUID() builds here:
+ * USB bus, a vendor, zero padding and no driver signature. The CRC and version are free.
+ */
+static SDL_bool SDL_PrivateIsMappingForBackend(const char *line, const char *line_end)
+{
+	if (line_end - line <= SDL_GAMEPAD_MAPPING_GUID_SIZE || line[SDL_GAMEPAD_MAPPING_GUID_SIZE] != ',') {
+		return SDL_FALSE;
+	}
+
+	return (SDL_memcmp(&line[0], "0300", 4) == 0 &&
+			SDL_memcmp(&line[8], "0000", 4) != 0 &&
+			SDL_memcmp(&line[12], "0000", 4) == 0 &&
+			SDL_memcmp(&line[20], "0000", 4) == 0 &&
+			SDL_memcmp(&line[28], "0000", 4) == 0) ? SDL_TRUE : SDL_FALSE;
+}
+
+/*
+ * Add the mappings of a database text, one per line, without copying it
+ */
+int SDL_AddGamepadMappingsFromMemory(const void *mem, size_t size)
+{
+	const char *buf = (const char *)mem;
+	const char *buf_end = buf + size;
+	const char *line_end;
+	char line[SDL_GAMEPAD_MAPPING_LINE_MAX];
+	size_t length;
+	int gamepads = 0;
+
+	if (!mem && size) {
+		return SDL_InvalidParamError("mem");
+	}
+
+	SDL_LockJoysticks();
+
+	PushMappingChangeTracking();
+
+	for (; buf < buf_end; buf = line_end + 1) {
+		line_end = SDL_memchr(buf, '\n', buf_end - buf);
+		if (!line_end) {
+			line_end = buf_end;
+		}
+
+		length = line_end - buf;
+		if (length && buf[length - 1] == '\r') {
+			--length;
+		}
+
+		/* Only the lines kept are copied, to terminate them for parsing */
+		if (length == 0 || buf[0] == '#' ||
+			!SDL_PrivateIsMappingForBackend(buf, buf + length) ||
+			!SDL_PrivateIsMappingForPlatform(buf, buf + length)) {
+			continue;
+		}
+		if (length >= sizeof(line)) {
+			LOG(LOG_WARNING, "Gamepad mapping too long: %.40s...\n", buf);
+			continue;
+		}
+
+		SDL_memcpy(line, buf, length);
+		line[length] = '\0';
+		if (SDL_PrivateAddGamepadMapping(line, SDL_GAMEPAD_MAPPING_PRIORITY_API) > 0) {
+			gamepads++;
+		}
+	}
+
+	PopMappingChangeTracking();
+
+	SDL_UnlockJoysticks();
+
+	return gamepads;
+}
+
+/*
+ * Add the mappings of a database file, mapped rather than read into memory
  */
+int SDL_AddGamepadMappingsFromFile(const char *file)
+{
+	struct stat st;
+	void *mem;
+	int fd, retval;
+
+	if (!file) {
+		return SDL_InvalidParamError("file");
+	}
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0) {
+		return SDL_SetError("Couldn't open %s: %s", file, strerror(errno));
+	}
+
+	if (fstat(fd, &st) < 0) {
+		retval = SDL_SetError("Couldn't stat %s: %s", file, strerror(errno));
+		close(fd);
+		return retval;
+	}
+
+	if (st.st_size == 0) {
+		close(fd);
+		return 0;
+	}
+
+	mem = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mem == MAP_FAILED) {
+		return SDL_SetError("Couldn't map %s: %s", file, strerror(errno));
+	}
+
+	retval = SDL_AddGamepadMappingsFromMemory(mem, st.st_size);
+
+	munmap(mem, st.st_size);
+
+	return retval;
+}
+
 static int SDL_SendGamepadButton(Uint64 timestamp, SDL_Gamepad *gamepad, SDL_GamepadButton button, Uint8 state)
 {
 	LOG(LOG_SDL_GAMEPAD_TRACE, "%s [%d] GamepadButton: %d (0x%x) %s\n",
 		__func__, __LINE__, button, button,
 		state == SDL_RELEASED ? "RELEASED" : "PRESSED");
 
-	if (!l_evt_q)
-		return 0;
+	SDL_Event event;
 
-	SDL_Event *ev = malloc(sizeof(SDL_Event));
-	ev->type = (state == SDL_RELEASED) ? SDL_CONTROLLERBUTTONUP : SDL_CONTROLLERBUTTONDOWN;
-	ev->cbutton.button = button;
+	if (button > SDL_GAMEPAD_BUTTON_INVALID && button < SDL_GAMEPAD_BUTTON_MAX) {
+		SDL_PrivateBeginStateUpdate(gamepad, timestamp);
+		gamepad->buttons[button] = state;
+		SDL_PrivateEndStateUpdate(gamepad);
+	}
 
-	enque(l_evt_q, ev);
+	SDL_zero(event);
+	event.type = (state == SDL_RELEASED) ? SDL_CONTROLLERBUTTONUP : SDL_CONTROLLERBUTTONDOWN;
+	event.common.timestamp = timestamp;
+	event.cbutton.which = gamepad->joystick->instance_id;
+	event.cbutton.button = button;
 
-	return 1;
+	return SDL_PushEvent(&event) == 1;
 }
 
 /*
@@ -1195,18 +1966,22 @@ static int SDL_SendGamepadAxis(Uint64 timestamp, SDL_Gamepad *gamepad, SDL_Gamep
 	}
 	return posted;
 #else
-	if (!l_evt_q)
-		return 0;
+	SDL_Event event;
 
-	SDL_Event *ev = malloc(sizeof(SDL_Event));
-	ev->type = SDL_EVENT_GAMEPAD_AXIS_MOTION;
-//	event.gaxis.which = gamepad->joystick->instance_id;
-	ev->gaxis.axis = axis;
-	ev->gaxis.value = value;
+	if (axis > SDL_GAMEPAD_AXIS_INVALID && axis < SDL_GAMEPAD_AXIS_MAX) {
+		SDL_PrivateBeginStateUpdate(gamepad, timestamp);
+		gamepad->axes[axis] = value;
+		SDL_PrivateEndStateUpdate(gamepad);
+	}
 
-	enque(l_evt_q, ev);
+	SDL_zero(event);
+	event.type = SDL_EVENT_GAMEPAD_AXIS_MOTION;
+	event.common.timestamp = timestamp;
+	event.gaxis.which = gamepad->joystick->instance_id;
+	event.gaxis.axis = axis;
+	event.gaxis.value = value;
 
-	return 1;
+	return SDL_PushEvent(&event) == 1;
 #endif
 }
 
@@ -1223,43 +1998,29 @@ static SDL_bool HasSameOutput(SDL_GamepadBinding *a, SDL_GamepadBinding *b)
 	}
 }
 
-static void ResetOutput(Uint64 timestamp, SDL_Gamepad *gamepad, SDL_GamepadBinding *bind)
+static void SendOutput(Uint64 timestamp, SDL_Gamepad *gamepad, SDL_GamepadBinding *bind, int value)
 {
 	if (bind->output_type == SDL_GAMEPAD_BINDTYPE_AXIS) {
-		SDL_SendGamepadAxis(timestamp, gamepad, bind->output.axis.axis, 0);
+		SDL_SendGamepadAxis(timestamp, gamepad, bind->output.axis.axis, (Sint16)value);
 	} else {
-		SDL_SendGamepadButton(timestamp, gamepad, bind->output.button, SDL_RELEASED);
+		SDL_SendGamepadButton(timestamp, gamepad, bind->output.button, (Uint8)value);
 	}
 }
 
+static void ResetOutput(Uint64 timestamp, SDL_Gamepad *gamepad, SDL_GamepadBinding *bind)
+{
+	SendOutput(timestamp, gamepad, bind, (bind->output_type == SDL_GAMEPAD_BINDTYPE_AXIS) ? 0 : SDL_RELEASED);
+}
+
 static void HandleJoystickAxis(Uint64 timestamp, SDL_Gamepad *gamepad, int axis, int value)
 {
-	int i;
 	SDL_GamepadBinding *last_match;
-	SDL_GamepadBinding *match = NULL;
+	SDL_GamepadBinding *match;
 
 	SDL_AssertJoysticksLocked();
 
 	last_match = gamepad->last_match_axis[axis];
-	for (i = 0; i < gamepad->num_bindings; ++i) {
-		SDL_GamepadBinding *binding = &gamepad->bindings[i];
-		if (binding->input_type == SDL_GAMEPAD_BINDTYPE_AXIS &&
-			axis == binding->input.axis.axis) {
-			if (binding->input.axis.axis_min < binding->input.axis.axis_max) {
-				if (value >= binding->input.axis.axis_min &&
-					value <= binding->input.axis.axis_max) {
-					match = binding;
-					break;
-				}
-			} else {
-				if (value >= binding->input.axis.axis_max &&
-					value <= binding->input.axis.axis_min) {
-					match = binding;
-					break;
-				}
-			}
-		}
-	}
+	match = SDL_PrivateMatchAxisBinding(gamepad, axis, value);
 
 	if (last_match && (!match || !HasSameOutput(last_match, match))) {
 		/* Clear the last input that this axis generated */
@@ -1267,70 +2028,38 @@ static void HandleJoystickAxis(Uint64 timestamp, SDL_Gamepad *gamepad, int axis,
 	}
 
 	if (match) {
-		if (match->output_type == SDL_GAMEPAD_BINDTYPE_AXIS) {
-			if (match->input.axis.axis_min != match->output.axis.axis_min || match->input.axis.axis_max != match->output.axis.axis_max) {
-				float normalized_value = (float)(value - match->input.axis.axis_min) / (match->input.axis.axis_max - match->input.axis.axis_min);
-				value = match->output.axis.axis_min + (int)(normalized_value * (match->output.axis.axis_max - match->output.axis.axis_min));
-			}
-			SDL_SendGamepadAxis(timestamp, gamepad, match->output.axis.axis, (Sint16)value);
-		} else {
-			Uint8 state;
-			int threshold = match->input.axis.axis_min + (match->input.axis.axis_max - match->input.axis.axis_min) / 2;
-			if (match->input.axis.axis_max < match->input.axis.axis_min) {
-				state = (value <= threshold) ? SDL_PRESSED : SDL_RELEASED;
-			} else {
-				state = (value >= threshold) ? SDL_PRESSED : SDL_RELEASED;
-			}
-			SDL_SendGamepadButton(timestamp, gamepad, match->output.button, state);
-		}
+		SendOutput(timestamp, gamepad, match, SDL_PrivateGetBindingOutput(match, value));
 	}
 	gamepad->last_match_axis[axis] = match;
 }
 
 static void HandleJoystickButton(Uint64 timestamp, SDL_Gamepad *gamepad, int button, Uint8 state)
 {
-	int i;
+	SDL_GamepadBinding **bindings;
 
 	SDL_AssertJoysticksLocked();
 
-	for (i = 0; i < gamepad->num_bindings; ++i) {
-		SDL_GamepadBinding *binding = &gamepad->bindings[i];
-		if (binding->input_type == SDL_GAMEPAD_BINDTYPE_BUTTON &&
-			button == binding->input.button) {
-			if (binding->output_type == SDL_GAMEPAD_BINDTYPE_AXIS) {
-				int value = state ? binding->output.axis.axis_max : binding->output.axis.axis_min;
-				SDL_SendGamepadAxis(timestamp, gamepad, binding->output.axis.axis, (Sint16)value);
-			} else {
-				SDL_SendGamepadButton(timestamp, gamepad, binding->output.button, state);
-			}
-			break;
-		}
+	/* Only the first binding of a button is used */
+	if (SDL_PrivateGetBindings(gamepad, GAMEPAD_TABLE_BUTTON, button, &bindings) > 0) {
+		SendOutput(timestamp, gamepad, bindings[0], SDL_PrivateGetBindingOutput(bindings[0], state));
 	}
 }
 
 static void HandleJoystickHat(Uint64 timestamp, SDL_Gamepad *gamepad, int hat, Uint8 value)
 {
-	int i;
+	int i, num_bindings;
+	SDL_GamepadBinding **bindings;
 	Uint8 last_mask, changed_mask;
 
 	SDL_AssertJoysticksLocked();
 
 	last_mask = gamepad->last_hat_mask[hat];
 	changed_mask = (last_mask ^ value);
-	for (i = 0; i < gamepad->num_bindings; ++i) {
-		SDL_GamepadBinding *binding = &gamepad->bindings[i];
-		if (binding->input_type == SDL_GAMEPAD_BINDTYPE_HAT && hat == binding->input.hat.hat) {
-			if ((changed_mask & binding->input.hat.hat_mask) != 0) {
-				if (value & binding->input.hat.hat_mask) {
-					if (binding->output_type == SDL_GAMEPAD_BINDTYPE_AXIS) {
-						SDL_SendGamepadAxis(timestamp, gamepad, binding->output.axis.axis, (Sint16)binding->output.axis.axis_max);
-					} else {
-						SDL_SendGamepadButton(timestamp, gamepad, binding->output.button, SDL_PRESSED);
-					}
-				} else {
-					ResetOutput(timestamp, gamepad, binding);
-				}
-			}
+	num_bindings = SDL_PrivateGetBindings(gamepad, GAMEPAD_TABLE_HAT, hat, &bindings);
+	for (i = 0; i < num_bindings; ++i) {
+		SDL_GamepadBinding *binding = bindings[i];
+		if ((changed_mask & binding->input.hat.hat_mask) != 0) {
+			SendOutput(timestamp, gamepad, binding, SDL_PrivateGetBindingOutput(binding, value & binding->input.hat.hat_mask));
 		}
 	}
 	gamepad->last_hat_mask[hat] = value;
@@ -1403,69 +2132,135 @@ int SDL_GamepadEventWatcher(void *userdata, SDL_Event *event)
 	return 1;
 }
 
+/*
+ * Return whether a gamepad has a given axis
+ */
+SDL_bool SDL_GamepadHasAxis(SDL_Gamepad *gamepad, SDL_GamepadAxis axis)
+{
+	SDL_GamepadBinding **bindings;
+	SDL_bool retval;
+
+	SDL_LockJoysticks();
+	{
+		CHECK_GAMEPAD_MAGIC(gamepad, SDL_FALSE);
+
+		retval = SDL_PrivateGetBindings(gamepad, GAMEPAD_TABLE_OUTPUT_AXIS, axis, &bindings) > 0;
+	}
+	SDL_UnlockJoysticks();
+
+	return retval;
+}
+
 /*
  * Get the current state of an axis control on a gamepad
+ *
+ * This is the value last sent for the axis, so it doesn't need the joystick lock.
+ * Nothing checks that the gamepad is still open, callers must not race SDL_CloseGamepad()
  */
 Sint16 SDL_GetGamepadAxis(SDL_Gamepad *gamepad, SDL_GamepadAxis axis)
 {
-	Sint16 retval = 0;
+	CHECK_GAMEPAD_MAGIC(gamepad, 0);
+
+	if (axis <= SDL_GAMEPAD_AXIS_INVALID || axis >= SDL_GAMEPAD_AXIS_MAX) {
+		SDL_InvalidParamError("axis");
+		return 0;
+	}
+
+	return gamepad->axes[axis];
+}
+
+/*
+ * Return whether a gamepad has a given button
+ */
+SDL_bool SDL_GamepadHasButton(SDL_Gamepad *gamepad, SDL_GamepadButton button)
+{
+	SDL_GamepadBinding **bindings;
+	SDL_bool retval;
 
 	SDL_LockJoysticks();
 	{
-		int i;
+		CHECK_GAMEPAD_MAGIC(gamepad, SDL_FALSE);
+
+		retval = SDL_PrivateGetBindings(gamepad, GAMEPAD_TABLE_OUTPUT_BUTTON, button, &bindings) > 0;
+	}
+	SDL_UnlockJoysticks();
 
-		CHECK_GAMEPAD_MAGIC(gamepad, 0);
+	return retval;
+}
 
-		for (i = 0; i < gamepad->num_bindings; ++i) {
-			SDL_GamepadBinding *binding = &gamepad->bindings[i];
-			if (binding->output_type == SDL_GAMEPAD_BINDTYPE_AXIS && binding->output.axis.axis == axis) {
-				int value = 0;
-				SDL_bool valid_input_range;
-				SDL_bool valid_output_range;
-
-				if (binding->input_type == SDL_GAMEPAD_BINDTYPE_AXIS) {
-					value = SDL_GetJoystickAxis(gamepad->joystick, binding->input.axis.axis);
-					if (binding->input.axis.axis_min < binding->input.axis.axis_max) {
-						valid_input_range = (value >= binding->input.axis.axis_min && value <= binding->input.axis.axis_max);
-					} else {
-						valid_input_range = (value >= binding->input.axis.axis_max && value <= binding->input.axis.axis_min);
-					}
-					if (valid_input_range) {
-						if (binding->input.axis.axis_min != binding->output.axis.axis_min || binding->input.axis.axis_max != binding->output.axis.axis_max) {
-							float normalized_value = (float)(value - binding->input.axis.axis_min) / (binding->input.axis.axis_max - binding->input.axis.axis_min);
-							value = binding->output.axis.axis_min + (int)(normalized_value * (binding->output.axis.axis_max - binding->output.axis.axis_min));
-						}
-					} else {
-						value = 0;
-					}
-				} else if (binding->input_type == SDL_GAMEPAD_BINDTYPE_BUTTON) {
-					value = SDL_GetJoystickButton(gamepad->joystick, binding->input.button);
-					if (value == SDL_PRESSED) {
-						value = binding->output.axis.axis_max;
-					}
-				} else if (binding->input_type == SDL_GAMEPAD_BINDTYPE_HAT) {
-					int hat_mask = SDL_GetJoystickHat(gamepad->joystick, binding->input.hat.hat);
-					if (hat_mask & binding->input.hat.hat_mask) {
-						value = binding->output.axis.axis_max;
-					}
-				}
+/*
+ * Get the current state of a button on a gamepad
+ *
+ * This is the state last sent for the button, so it doesn't need the joystick lock.
+ * Nothing checks that the gamepad is still open, callers must not race SDL_CloseGamepad()
+ */
+Uint8 SDL_GetGamepadButton(SDL_Gamepad *gamepad, SDL_GamepadButton button)
+{
+	CHECK_GAMEPAD_MAGIC(gamepad, 0);
 
-				if (binding->output.axis.axis_min < binding->output.axis.axis_max) {
-					valid_output_range = (value >= binding->output.axis.axis_min && value <= binding->output.axis.axis_max);
-				} else {
-					valid_output_range = (value >= binding->output.axis.axis_max && value <= binding->output.axis.axis_min);
-				}
-				/* If the value is zero, there might be another binding that makes it non-zero */
-				if (value != 0 && valid_output_range) {
-					retval = (Sint16)value;
-					break;
-				}
-			}
+	if (button <= SDL_GAMEPAD_BUTTON_INVALID || button >= SDL_GAMEPAD_BUTTON_MAX) {
+		SDL_InvalidParamError("button");
+		return 0;
+	}
+
+	return gamepad->buttons[button];
+}
+
+static void SDL_PrivateCopyGamepadState(SDL_Gamepad *gamepad, SDL_GamepadState *state)
+{
+	int i;
+
+	state->timestamp = gamepad->state_timestamp;
+	for (i = 0; i < SDL_GAMEPAD_AXIS_MAX; ++i) {
+		state->axes[i] = gamepad->axes[i];
+	}
+	for (i = 0; i < SDL_GAMEPAD_BUTTON_MAX; ++i) {
+		state->buttons[i] = gamepad->buttons[i];
+	}
+}
+
+/*
+ * Get the state of all axes and buttons of a gamepad at once
+ *
+ * Lock free like SDL_GetGamepadAxis() as long as no update runs meanwhile, callers
+ * must not race SDL_CloseGamepad()
+ */
+int SDL_GetGamepadState(SDL_Gamepad *gamepad, SDL_GamepadState *state)
+{
+	Uint32 seq;
+	int tries;
+
+	CHECK_GAMEPAD_MAGIC(gamepad, -1);
+
+	if (!state) {
+		return SDL_InvalidParamError("state");
+	}
+
+	for (tries = 0; tries < SDL_GAMEPAD_STATE_TRIES; ++tries) {
+		seq = gamepad->state_seq;
+		if (seq & 1) {
+			continue;
+		}
+		__sync_synchronize();
+
+		SDL_PrivateCopyGamepadState(gamepad, state);
+
+		__sync_synchronize();
+		if (seq == gamepad->state_seq) {
+			return 0;
 		}
 	}
+
+	/*
+	 * Updates keep overlapping, or the updating thread was preempted in the
+	 * middle of one. Spinning on would starve it under priority scheduling,
+	 * updates are made with the joystick lock held so wait for it instead.
+	 */
+	SDL_LockJoysticks();
+	SDL_PrivateCopyGamepadState(gamepad, state);
 	SDL_UnlockJoysticks();
 
-	return retval;
+	return 0;
 }
 
 /*
@@ -1561,15 +2356,11 @@ void SDL_PrivateGamepadAdded(SDL_JoystickID instance_id)
 	event.gdevice.which = instance_id;
 	SDL_PushEvent(&event);
 #else
-	if (!l_evt_q)
-		return;
-
-	SDL_Event *ev = malloc(sizeof(SDL_Event));
-	ev->type = SDL_EVENT_GAMEPAD_ADDED;
-	ev->common.timestamp = 0;
-	ev->gdevice.which = instance_id;
-
-	enque(l_evt_q, ev);
+	SDL_zero(event);
+	event.type = SDL_EVENT_GAMEPAD_ADDED;
+	event.common.timestamp = 0;
+	event.gdevice.which = instance_id;
+	SDL_PushEvent(&event);
 #endif
 	LOG(LOG_SDL_GAMEPAD_TRACE, "%s [%d] -\n", __func__, __LINE__);
 }
@@ -1599,15 +2390,11 @@ void SDL_PrivateGamepadRemoved(SDL_JoystickID instance_id)
 	event.gdevice.which = instance_id;
 	SDL_PushEvent(&event);
 #else
-	if (!l_evt_q)
-		return;
-
-	SDL_Event *ev = malloc(sizeof(SDL_Event));
-	ev->type = SDL_EVENT_GAMEPAD_REMOVED;
-	ev->common.timestamp = 0;
-	ev->gdevice.which = instance_id;
-
-	enque(l_evt_q, ev);
+	SDL_zero(event);
+	event.type = SDL_EVENT_GAMEPAD_REMOVED;
+	event.common.timestamp = 0;
+	event.gdevice.which = instance_id;
+	SDL_PushEvent(&event);
 #endif
 
 	LOG(LOG_SDL_GAMEPAD_TRACE, "%s [%d] -\n", __func__, __LINE__);
@@ -1621,6 +2408,7 @@ int SDL_InitGamepadMappings(void)
 	char szGamepadMapPath[1024];
 	int i = 0;
 	const char *pMappingString = NULL;
+	const char *pMappingFile;
 
 	LOG(LOG_SDL_GAMEPAD_TRACE, "%s [%d] +\n", __func__, __LINE__);
 
@@ -1628,12 +2416,16 @@ int SDL_InitGamepadMappings(void)
 
 	PushMappingChangeTracking();
 
-	pMappingString = s_GamepadMappings[i];
-	while (pMappingString) {
+	/* Mappings with a GUID stay in the compiled database until a gamepad needs them */
+	for (i = 0; i < SDL_GAMEPAD_DB_UNHASHED; i++) {
+		pMappingString = s_GamepadMappings[s_GamepadDBUnhashed[i]];
 		SDL_PrivateAddGamepadMapping(pMappingString, SDL_GAMEPAD_MAPPING_PRIORITY_DEFAULT);
+	}
 
-		i++;
-		pMappingString = s_GamepadMappings[i];
+	/* A mappings database shipped apart from the library, like gamecontrollerdb.txt */
+	pMappingFile = getenv("SDL_GAMECONTROLLERCONFIG_FILE");
+	if (pMappingFile) {
+		SDL_AddGamepadMappingsFromFile(pMappingFile);
 	}
 #if 0
 	if (SDL_GetGamepadMappingFilePath(szGamepadMapPath, sizeof(szGamepadMapPath))) {
@@ -20,7 +20,7 @@
 */
 #if 0
 #include "SDL_internal.h"
-#else
+#elif !defined(SDL_GAMEPAD_DB_GENERATOR)
 #include "internal.h"
 #endif
 /* Default mappings we support
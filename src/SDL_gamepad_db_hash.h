@@ -0,0 +1,54 @@
+#ifndef SDL_GAMEPAD_DB_HASH_H
+#define SDL_GAMEPAD_DB_HASH_H
+
+/*
+ * Hash of a 16 byte joystick GUID, shared by tools/gamepad_db_gen and the
+ * lookup in SDL_gamepad.c so both place a GUID in the same slot.
+ *
+ * The compiled database is a two level perfect hash: seed 0 selects a bucket,
+ * the seed stored for that bucket selects the slot.
+ */
+static inline unsigned int SDL_GamepadDBHash(const unsigned char *guid, unsigned int seed)
+{
+	unsigned int hash = 2166136261u ^ (seed * 0x9e3779b9u);
+	int i;
+
+	/* FNV-1a, then a final mix so the low bits depend on every byte */
+	for (i = 0; i < 16; ++i) {
+		hash ^= guid[i];
+		hash *= 16777619u;
+	}
+	hash ^= hash >> 15;
+	hash *= 0x2c1b3c6du;
+	hash ^= hash >> 12;
+
+	return hash;
+}
+
+/*
+ * Hash of an axis or button name as written in a mapping, ignoring case and
+ * spaces. The generator picks the seed placing every name of
+ * SDL_gamepad_names.h in a slot of its own.
+ */
+static inline unsigned int SDL_GamepadElementHash(const char *name, const char *name_end, unsigned int seed)
+{
+	unsigned int hash = 2166136261u ^ (seed * 0x9e3779b9u);
+	unsigned char c;
+
+	for (; name < name_end; ++name) {
+		c = (unsigned char)*name;
+		if (c == ' ')
+			continue;
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		hash ^= c;
+		hash *= 16777619u;
+	}
+	hash ^= hash >> 15;
+	hash *= 0x2c1b3c6du;
+	hash ^= hash >> 12;
+
+	return hash;
+}
+
+#endif
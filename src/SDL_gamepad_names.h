@@ -0,0 +1,48 @@
+#ifndef SDL_GAMEPAD_NAMES_H
+#define SDL_GAMEPAD_NAMES_H
+
+/*
+ * Axis and button names of the mapping strings, shared by tools/gamepad_db_gen
+ * and SDL_gamepad.c. The generator hashes them into the element table the
+ * mapping parser looks names up in, so both must see the same list.
+ */
+
+static const char *map_StringForGamepadAxis[] = {
+	"leftx",
+	"lefty",
+	"rightx",
+	"righty",
+	"lefttrigger",
+	"righttrigger"
+};
+
+static const char *map_StringForGamepadButton[] = {
+	"a",
+	"b",
+	"x",
+	"y",
+	"back",
+	"guide",
+	"start",
+	"leftstick",
+	"rightstick",
+	"leftshoulder",
+	"rightshoulder",
+	"dpup",
+	"dpdown",
+	"dpleft",
+	"dpright",
+	"misc1",
+	"paddle1",
+	"paddle2",
+	"paddle3",
+	"paddle4",
+	"touchpad",
+	"misc2",
+	"misc3",
+	"misc4",
+	"misc5",
+	"misc6"
+};
+
+#endif
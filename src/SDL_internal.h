@@ -20,6 +20,7 @@
 #define SDL_memset memset
 #endif
 #define SDL_memcmp memcmp
+#define SDL_memchr memchr
 #define SDL_strlcpy strlcpy
 #define SDL_strlcat strlcat
 #define SDL_strlen strlen
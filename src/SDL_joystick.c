@@ -1,6 +1,8 @@
 #include <SDL3/SDL_events.h>
 #include <SDL3/SDL_gamepad.h>
 
+#include <pthread.h>
+
 #include "internal.h"
 
 #include "SDL_sysjoystick.h"
@@ -23,9 +25,36 @@ static SDL_bool SDL_joysticks_initialized;
 static SDL_Joystick *SDL_joysticks SDL_GUARDED_BY(SDL_joystick_lock) = NULL;
 char SDL_joystick_magic;
 
+/*
+ * The HID thread delivers reports under this lock while the application opens
+ * and closes joysticks. It is recursive like SDL's, the gamepad functions
+ * call joystick functions with the lock held.
+ */
+static pthread_mutex_t SDL_joystick_lock;
+static pthread_once_t SDL_joystick_lock_once = PTHREAD_ONCE_INIT;
+
+static void SDL_InitJoystickLock(void)
+{
+	pthread_mutexattr_t attr;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&SDL_joystick_lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
 void SDL_AssertJoysticksLocked(void) {};
-void SDL_LockJoysticks(void) {};
-void SDL_UnlockJoysticks(void) {};
+
+void SDL_LockJoysticks(void)
+{
+	pthread_once(&SDL_joystick_lock_once, SDL_InitJoystickLock);
+	pthread_mutex_lock(&SDL_joystick_lock);
+}
+
+void SDL_UnlockJoysticks(void)
+{
+	pthread_mutex_unlock(&SDL_joystick_lock);
+}
 
 /* convert the string version of a joystick guid to the struct */
 SDL_JoystickGUID SDL_GetJoystickGUIDFromString(const char *pchGUID)
@@ -180,6 +209,16 @@ static SDL_bool SDL_GetDriverAndJoystickIndex(SDL_JoystickID instance_id, SDL_Jo
 
 	if (instance_id > 0) {
 		for (i = 0; i < SDL_arraysize(SDL_joystick_drivers); ++i) {
+			if (SDL_joystick_drivers[i]->GetDeviceIndexForInstanceID) {
+				device_index = SDL_joystick_drivers[i]->GetDeviceIndexForInstanceID(instance_id);
+				if (device_index >= 0) {
+					*driver = SDL_joystick_drivers[i];
+					*driver_index = device_index;
+					return SDL_TRUE;
+				}
+				continue;
+			}
+
 			num_joysticks = SDL_joystick_drivers[i]->GetCount();
 			for (device_index = 0; device_index < num_joysticks; ++device_index) {
 				SDL_JoystickID joystick_id = SDL_joystick_drivers[i]->GetDeviceInstanceID(device_index);
@@ -815,6 +854,10 @@ int SDL_InitJoysticks(void)
 			status = 0;
 		}
 	}
+
+	SDL_UnlockJoysticks();
+
+	return status;
 }
 
 int SDL_NumJoysticks(void)
@@ -676,22 +676,19 @@ const char *SDL_GetScancodeName(SDL_Scancode scancode)
 int SDL_SendKeyboardKey(uint64_t timestamp, uint8_t state, SDL_Scancode scancode)
 {
 	SDL_Keycode keycode;
+	SDL_Event event;
 
 	LOG(LOG_SDL_KEYBOARD_TRACE, "%s [%d] Key: %s (0x%x) was %s\n", __func__, __LINE__,
 	    SDL_GetScancodeName(scancode), scancode, state == SDL_RELEASED ? "RELEASED" : "PRESSED");
 
-	if (!l_evt_q)
-		return 0;
-
 	keycode = SDL_default_keymap[scancode];
 
-	SDL_Event *ev = malloc(sizeof(SDL_Event));
-	ev->type = (state == SDL_RELEASED) ? SDL_EVENT_KEY_UP : SDL_EVENT_KEY_DOWN;
-	ev->key.keysym.sym = keycode;
-
-	enque(l_evt_q, ev);
+	SDL_zero(event);
+	event.type = (state == SDL_RELEASED) ? SDL_EVENT_KEY_UP : SDL_EVENT_KEY_DOWN;
+	event.common.timestamp = timestamp;
+	event.key.keysym.sym = keycode;
 
-	return 1;
+	return SDL_PushEvent(&event) == 1;
 }
 
 // https://github.com/libsdl-org/SDL/blob/main/src/video/qnx/SDL_qnxkeyboard.c#L128
@@ -700,10 +697,16 @@ int handleKeyboardEvent(input_module_t *module, int data_size, void * data)
 	int		val;
 	SDL_Scancode	scancode;
 
-	uint16_t *keys_data = (uint16_t *)data;
-	int i, num_keys = data_size / sizeof(keys_data[0]);
+	pKeyboard_raw_data_t k_data = (pKeyboard_raw_data_t)data;
+	uint16_t *keys_data = k_data->keys;
+	int i, num_keys;
 	uint8_t is_pressed;
 
+	if (data_size < (int)offsetof(keyboard_raw_data_t, keys))
+		return -1;
+
+	num_keys = (data_size - offsetof(keyboard_raw_data_t, keys)) / sizeof(keys_data[0]);
+
 	LOG(LOG_SDL_KEYBOARD_TRACE, "%s %d data_size: %d num_keys: %d\n",
 	    __func__, __LINE__, data_size, num_keys);
 
@@ -732,7 +735,7 @@ int handleKeyboardEvent(input_module_t *module, int data_size, void * data)
 		// Propagate the event to SDL.
 		// FIXME:
 		// Need to handle more key states (such as key combinations).
-		SDL_SendKeyboardKey(0, is_pressed, keys_data[i]);
+		SDL_SendKeyboardKey(k_data->timestamp, is_pressed, keys_data[i]);
 	}
 
 	return 0;
@@ -1,5 +1,6 @@
 #include <SDL3/SDL_events.h>
 #include "internal.h"
+#include "button_mask.h"
 
 int SDL_SendMouseButton(uint64_t timestamp, int key_state, int key_code)
 {
@@ -7,16 +8,14 @@ int SDL_SendMouseButton(uint64_t timestamp, int key_state, int key_code)
 	    __func__, __LINE__, key_code, key_code,
 	    key_state == SDL_RELEASED ? "RELEASED" : "PRESSED");
 
-	if (!l_evt_q)
-		return 0;
+	SDL_Event event;
 
-	SDL_Event *ev = malloc(sizeof(SDL_Event));
-	ev->type = (key_state == SDL_RELEASED) ? SDL_EVENT_MOUSE_BUTTON_UP : SDL_EVENT_MOUSE_BUTTON_DOWN;
-	ev->button.button = key_code;
+	SDL_zero(event);
+	event.type = (key_state == SDL_RELEASED) ? SDL_EVENT_MOUSE_BUTTON_UP : SDL_EVENT_MOUSE_BUTTON_DOWN;
+	event.common.timestamp = timestamp;
+	event.button.button = key_code;
 
-	enque(l_evt_q, ev);
-
-	return 1;
+	return SDL_PushEvent(&event) == 1;
 }
 
 int SDL_SendMouseWheel(uint64_t timestamp, int z1, int wheel)
@@ -24,15 +23,14 @@ int SDL_SendMouseWheel(uint64_t timestamp, int z1, int wheel)
 	LOG(LOG_SDL_GAMEPAD_TRACE, "%s [%d] Mouse wheel: %d (0x%x)\n",
 	    __func__, __LINE__, wheel, wheel);
 
-	if (!l_evt_q)
-		return 0;
+	SDL_Event event;
 
-	SDL_Event *ev = malloc(sizeof(SDL_Event));
-	ev->type = SDL_EVENT_MOUSE_WHEEL;
-	ev->wheel.y = wheel;
-	enque(l_evt_q, ev);
+	SDL_zero(event);
+	event.type = SDL_EVENT_MOUSE_WHEEL;
+	event.common.timestamp = timestamp;
+	event.wheel.y = wheel;
 
-	return 1;
+	return SDL_PushEvent(&event) == 1;
 }
 
 int SDL_SendMouseMotion(uint64_t timestamp, int z1, int horizontal_precision, int vertical_precision, int z2)
@@ -40,25 +38,29 @@ int SDL_SendMouseMotion(uint64_t timestamp, int z1, int horizontal_precision, in
 	LOG(LOG_SDL_GAMEPAD_TRACE, "%s [%d] Mouse H: %04d V: %04d\n",
 	    __func__, __LINE__, horizontal_precision, vertical_precision);
 
-	if (!l_evt_q)
-		return 0;
+	SDL_Event event;
+
+	SDL_zero(event);
+	event.type = SDL_EVENT_MOUSE_MOTION;
+	event.common.timestamp = timestamp;
+	event.motion.xrel = horizontal_precision;
+	event.motion.yrel = vertical_precision;
 
-	SDL_Event *ev = malloc(sizeof(SDL_Event));
-	ev->type = SDL_EVENT_MOUSE_MOTION;
-	ev->motion.xrel = horizontal_precision;
-	ev->motion.yrel = vertical_precision;
+	return SDL_PushEvent(&event) == 1;
+}
 
-	enque(l_evt_q, ev);
+static void sendMouseButton(void *data, int button, int pressed)
+{
+	pMouse_raw_data_t m_data = (pMouse_raw_data_t)data;
 
-	return 1;
+	SDL_SendMouseButton(m_data->timestamp, pressed ? SDL_PRESSED : SDL_RELEASED, button);
 }
 
 int handleMouseEvent(input_module_t *module, int data_size, void * data)
 {
-	static uint8_t prevBtnStates; //FIXME: this will not work for 2 or more mouses
+	static uint64_t prevBtnStates; //FIXME: this will not work for 2 or more mouses
 	pMouse_raw_data_t m_data;
-	uint8_t changedBtnStates;
-	int i;
+	uint64_t btnStates;
 
 	if (data_size < sizeof(mouse_raw_data_t))
 		return -1;
@@ -70,29 +72,16 @@ int handleMouseEvent(input_module_t *module, int data_size, void * data)
 
 	/* Send motion event if motion really was */
 	if ((m_data->x != 0) || (m_data->y != 0))
-		SDL_SendMouseMotion(0, 1, m_data->x, m_data->y, 0);
+		SDL_SendMouseMotion(m_data->timestamp, 1, m_data->x, m_data->y, 0);
 
 	/* Send mouse button press/release events */
-	changedBtnStates = prevBtnStates ^ m_data->btnStates;
-	if (changedBtnStates) {
-		/* Cycle all buttons status */
-		for (i = 0; i < 8; i++) {
-			if (!((1 << i) & changedBtnStates))
-				continue;
-			
-			if ((1 << i) & m_data->btnStates)
-				SDL_SendMouseButton(0, SDL_PRESSED, i);
-			else
-				SDL_SendMouseButton(0, SDL_RELEASED, i);
-		}
-
-		prevBtnStates = m_data->btnStates;
-	}
+	btnStates = m_data->btnStates;
+	button_mask_diff(&prevBtnStates, &btnStates, 1, sendMouseButton, m_data);
 
 	/* Send mouse wheel events */
 	/* Send vertical wheel event only */
 	if (m_data->z != 0)
-		SDL_SendMouseWheel(0, 0, m_data->z);
+		SDL_SendMouseWheel(m_data->timestamp, 0, m_data->z);
 	
 	return 0;
 }
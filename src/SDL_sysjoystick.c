@@ -1,11 +1,28 @@
-#include <math.h>
-
 #include "SDL_sysjoystick.h"
 #include "SDL_joystick_c.h"
 
 #include "internal.h"
+#include "button_mask.h"
+
+/* Axis values are mapped to SDL_JOYSTICK_AXIS_MIN..MAX with (value - minimum) * multiplier >> AXIS_SCALE_SHIFT */
+#define AXIS_SCALE_SHIFT	32
 
-static SDL_Joystick *g_joystick;
+typedef struct joystick_axis_scale
+{
+	int minimum;		/* HID logical minimum */
+	int maximum;		/* HID logical maximum */
+	Sint64 multiplier;
+} joystick_axis_scale;
+
+/* State of an opened joystick */
+struct joystick_hwdata
+{
+	struct SDL_joylist_item *item;	/* NULL once the device is removed */
+	SDL_Joystick *joystick;
+	joystick_axis_scale axes[JOYSTICK_AXIS_MAX];	/* in SDL axis order */
+	Uint64 button_state;		/* buttons of the last report */
+	Uint64 timestamp;		/* of the report being handled */
+};
 
 Uint32 SDL_GetNextObjectID(void)
 {
@@ -18,7 +35,7 @@ Uint32 SDL_GetNextObjectID(void)
 	return id;
 }
 
-/* A linked list of available joysticks */
+/* Available joysticks, see SDL_joylist */
 typedef struct SDL_joylist_item
 {
 	SDL_JoystickID device_instance;
@@ -30,9 +47,11 @@ typedef struct SDL_joylist_item
 	dev_t devnum;
 #if 0
 	int steam_virtual_gamepad_slot;
-	struct joystick_hwdata *hwdata;
 #endif
-	struct SDL_joylist_item *next;
+	struct joystick_hwdata *hwdata;	/* set while the joystick is open */
+	int device_index;		/* position in SDL_joylist */
+	struct SDL_joylist_item *next_devnum;	/* hash chain of SDL_joylist_by_devnum */
+	struct SDL_joylist_item *next_instance;	/* hash chain of SDL_joylist_by_instance */
 #if 0
 	/* Steam Controller support */
 	SDL_bool m_bSteamController;
@@ -41,12 +60,50 @@ typedef struct SDL_joylist_item
 	SDL_GamepadMapping *mapping;
 #endif
 	joystick_attrib_t jattr;
+	joystick_axis_scale axes[JOYSTICK_AXIS_MAX];	/* in SDL axis order */
 } SDL_joylist_item;
 
-static SDL_joylist_item *SDL_joylist SDL_GUARDED_BY(SDL_joystick_lock) = NULL;
-static SDL_joylist_item *SDL_joylist_tail SDL_GUARDED_BY(SDL_joystick_lock) = NULL;
+/*
+ * Joysticks by device index, and hashed by devno and by instance id, so
+ * enumeration, open and report routing don't depend on the number of
+ * devices. The array is never reallocated: the HID thread adds and removes
+ * devices while the application enumerates them.
+ */
+#define MAX_JOYSTICKS		32
+#define JOYLIST_HASH_SIZE	16	/* power of two */
+#define JOYLIST_HASH(key)	((Uint32)(key) & (JOYLIST_HASH_SIZE - 1))
+
+static SDL_joylist_item *SDL_joylist[MAX_JOYSTICKS] SDL_GUARDED_BY(SDL_joystick_lock);
+static SDL_joylist_item *SDL_joylist_by_devnum[JOYLIST_HASH_SIZE] SDL_GUARDED_BY(SDL_joystick_lock);
+static SDL_joylist_item *SDL_joylist_by_instance[JOYLIST_HASH_SIZE] SDL_GUARDED_BY(SDL_joystick_lock);
 static int numjoysticks SDL_GUARDED_BY(SDL_joystick_lock) = 0;
 
+static SDL_joylist_item *GetJoystickByDevnum(dev_t devnum)
+{
+	SDL_joylist_item *item;
+
+	for (item = SDL_joylist_by_devnum[JOYLIST_HASH(devnum)]; item; item = item->next_devnum) {
+		if (item->devnum == devnum) {
+			break;
+		}
+	}
+
+	return item;
+}
+
+static SDL_joylist_item *GetJoystickByInstanceID(SDL_JoystickID instance_id)
+{
+	SDL_joylist_item *item;
+
+	for (item = SDL_joylist_by_instance[JOYLIST_HASH(instance_id)]; item; item = item->next_instance) {
+		if (item->device_instance == instance_id) {
+			break;
+		}
+	}
+
+	return item;
+}
+
 #if 0
 static int IsJoystick(const char *path, int fd, char **name_return, Uint16 *vendor_return, Uint16 *product_return, SDL_JoystickGUID *guid)
 {
@@ -89,6 +146,21 @@ static int IsJoystick(const char *path, int fd, char **name_return, Uint16 *vend
 }
 #endif
 
+static void SetupAxisScale(joystick_axis_scale *scale, const struct axis_correct *correct)
+{
+	scale->minimum = correct->minimum;
+	scale->maximum = correct->maximum;
+
+	/* No usable logical range, assume an 8-bit axis */
+	if (scale->maximum <= scale->minimum) {
+		scale->minimum = 0;
+		scale->maximum = 255;
+	}
+
+	scale->multiplier = (((Sint64)SDL_JOYSTICK_AXIS_MAX - SDL_JOYSTICK_AXIS_MIN) << AXIS_SCALE_SHIFT) /
+			    ((Sint64)scale->maximum - scale->minimum);
+}
+
 static void MaybeAddDevice(const joystick_attrib_t *jattr)
 {
 	SDL_JoystickGUID guid;
@@ -101,10 +173,14 @@ static void MaybeAddDevice(const joystick_attrib_t *jattr)
 	SDL_LockJoysticks();
 
 	/* Check to make sure it's not already in list. */
-	for (item = SDL_joylist; item; item = item->next) {
-		if (jattr->devno == item->devnum) {
-			goto done; /* already have this one */
-		}
+	if (GetJoystickByDevnum(jattr->devno)) {
+		goto done; /* already have this one */
+	}
+
+	if (numjoysticks >= MAX_JOYSTICKS) {
+		LOG(LOG_WARNING, "Joystick %d ignored, %d joysticks already attached\n",
+		    jattr->devno, numjoysticks);
+		goto done;
 	}
 
 	LOG(LOG_SDL_SYSJOYSTICK_TRACE, "Joystick: %d, bustype = %d, vendor = 0x%.4x, product = 0x%.4x, version = %d\n",
@@ -126,17 +202,26 @@ static void MaybeAddDevice(const joystick_attrib_t *jattr)
 	item->guid = guid;
 
 	item->device_instance = SDL_GetNextObjectID();
-	if (!SDL_joylist_tail) {
-		SDL_joylist = SDL_joylist_tail = item;
-	} else {
-		SDL_joylist_tail->next = item;
-		SDL_joylist_tail = item;
-	}
 
 	{
+		int i;
+
 		item->jattr = *jattr;
+
+		for (i = 0; i < jattr->naxis && i < JOYSTICK_AXIS_MAX; i++) {
+			SetupAxisScale(&item->axes[i],
+				       &jattr->abs_correct[jattr->axes[i].usage]);
+		}
 	}
 
+	item->device_index = numjoysticks;
+	SDL_joylist[item->device_index] = item;
+
+	item->next_devnum = SDL_joylist_by_devnum[JOYLIST_HASH(item->devnum)];
+	SDL_joylist_by_devnum[JOYLIST_HASH(item->devnum)] = item;
+	item->next_instance = SDL_joylist_by_instance[JOYLIST_HASH(item->device_instance)];
+	SDL_joylist_by_instance[JOYLIST_HASH(item->device_instance)] = item;
+
 	/* Need to increment the joystick count before we post the event */
 	++numjoysticks;
 
@@ -147,24 +232,31 @@ done:
 	SDL_UnlockJoysticks();
 }
 
-static void RemoveJoylistItem(SDL_joylist_item *item, SDL_joylist_item *prev)
+static void RemoveJoylistItem(SDL_joylist_item *item)
 {
+	SDL_joylist_item **link;
+	int i;
+
 	SDL_AssertJoysticksLocked();
-#if 0
+
 	if (item->hwdata) {
 		item->hwdata->item = NULL;
 	}
-#endif
-	if (prev) {
-		prev->next = item->next;
-	} else {
-		SDL_assert(SDL_joylist == item);
-		SDL_joylist = item->next;
+
+	for (link = &SDL_joylist_by_devnum[JOYLIST_HASH(item->devnum)]; *link != item; link = &(*link)->next_devnum) {
+	}
+	*link = item->next_devnum;
+
+	for (link = &SDL_joylist_by_instance[JOYLIST_HASH(item->device_instance)]; *link != item; link = &(*link)->next_instance) {
 	}
+	*link = item->next_instance;
 
-	if (item == SDL_joylist_tail) {
-		SDL_joylist_tail = prev;
+	/* Keep device indexes dense, in order of arrival */
+	for (i = item->device_index + 1; i < numjoysticks; i++) {
+		SDL_joylist[i - 1] = SDL_joylist[i];
+		SDL_joylist[i - 1]->device_index = i - 1;
 	}
+	SDL_joylist[numjoysticks - 1] = NULL;
 
 	/* Need to decrement the joystick count before we post the event */
 	--numjoysticks;
@@ -180,7 +272,6 @@ static void RemoveJoylistItem(SDL_joylist_item *item, SDL_joylist_item *prev)
 static void MaybeRemoveDevice(uint32_t *devno)
 {
 	SDL_joylist_item *item;
-	SDL_joylist_item *prev = NULL;
 
 	if (!devno) {
 		return;
@@ -188,13 +279,10 @@ static void MaybeRemoveDevice(uint32_t *devno)
 
 	SDL_LockJoysticks();
 
-	for (item = SDL_joylist; item; item = item->next) {
-		/* found it, remove it. */
-		if (*devno == item->devnum) {
-			RemoveJoylistItem(item, prev);
-			break;
-		}
-		prev = item;
+	/* found it, remove it. */
+	item = GetJoystickByDevnum(*devno);
+	if (item) {
+		RemoveJoylistItem(item);
 	}
 
 	SDL_UnlockJoysticks();
@@ -227,22 +315,13 @@ static SDL_bool QNX_JoystickIsDevicePresent(Uint16 vendor_id, Uint16 product_id,
 
 static SDL_joylist_item *GetJoystickByDevIndex(int device_index)
 {
-	SDL_joylist_item *item;
-
 	SDL_AssertJoysticksLocked();
 
 	if ((device_index < 0) || (device_index >= numjoysticks)) {
 		return NULL;
 	}
 
-	item = SDL_joylist;
-	while (device_index > 0) {
-		SDL_assert(item != NULL);
-		device_index--;
-		item = item->next;
-	}
-
-	return item;
+	return SDL_joylist[device_index];
 }
 
 static const char *QNX_JoystickGetDeviceName(int device_index)
@@ -282,6 +361,17 @@ static SDL_JoystickID QNX_JoystickGetDeviceInstanceID(int device_index)
 	return GetJoystickByDevIndex(device_index)->device_instance;
 }
 
+static int QNX_JoystickGetDeviceIndexForInstanceID(SDL_JoystickID instance_id)
+{
+	SDL_joylist_item *item;
+
+	SDL_AssertJoysticksLocked();
+
+	item = GetJoystickByInstanceID(instance_id);
+
+	return item ? item->device_index : -1;
+}
+
 static void ConfigJoystick(SDL_Joystick *joystick,
 			   const joystick_attrib_t *jattr)
 {
@@ -313,8 +403,21 @@ static int QNX_JoystickOpen(SDL_Joystick *joystick, int device_index)
 	/* Get the number of buttons and axes on the joystick */
 	ConfigJoystick(joystick, &item->jattr);
 
-	// FIXME:
-	g_joystick = joystick;
+	/* The item goes away when the device is removed, keep what reports need */
+	joystick->hwdata = (struct joystick_hwdata *)SDL_calloc(1, sizeof(*joystick->hwdata));
+	if (!joystick->hwdata) {
+		return SDL_OutOfMemory();
+	}
+	joystick->hwdata->item = item;
+	joystick->hwdata->joystick = joystick;
+	SDL_memcpy(joystick->hwdata->axes, item->axes, sizeof(item->axes));
+
+	/* Reports of this device are routed to the joystick from now on */
+	__sync_synchronize();
+	item->hwdata = joystick->hwdata;
+
+	/* The pad may be idle with buttons held, get its current state */
+	devi_hid_resend_reports();
 
 	LOG(LOG_SDL_SYSJOYSTICK_TRACE, "%s [%d] -\n",
 	    __func__, __LINE__);
@@ -358,7 +461,19 @@ static void QNX_JoystickClose(SDL_Joystick *joystick)
 	LOG(LOG_SDL_SYSJOYSTICK_TRACE, "%s [%d] +\n",
 	    __func__, __LINE__);
 
-	g_joystick = NULL;
+	/* The HID thread may be dispatching a report to this joystick */
+	SDL_LockJoysticks();
+	if (joystick->hwdata) {
+		if (joystick->hwdata->item) {
+			joystick->hwdata->item->hwdata = NULL;
+		}
+		SDL_free(joystick->hwdata);
+		joystick->hwdata = NULL;
+	}
+	SDL_UnlockJoysticks();
+
+	/* A joystick opened again starts from the current state */
+	devi_hid_resend_reports();
 }
 
 static void QNX_JoystickQuit(void)
@@ -393,37 +508,31 @@ int handleJoystickRemove(input_module_t *module, int data_size, void * data)
 	return 0;
 }
 
-static int AxisCorrect(int value)
+static int AxisCorrect(const joystick_axis_scale *scale, int value)
 {
-	float value_range = (255 - 0);
-	float output_range = (SDL_JOYSTICK_AXIS_MAX - SDL_JOYSTICK_AXIS_MIN);
-	float scale = 256; //(output_range / value_range);
-
-	value = (int)floorf((value - 0) * scale + SDL_JOYSTICK_AXIS_MIN + 0.5f);
-	// fprintf(stdout, "update_axis#%d: val: %d v2 %d, res: %d\n",axis, value, v2,(int)floorf((value - 0) * scale + SDL_JOYSTICK_AXIS_MIN + 0.5f));
-
 	/* Clamp and return */
-	if (value < SDL_JOYSTICK_AXIS_MIN) {
+	if (value <= scale->minimum) {
 		return SDL_JOYSTICK_AXIS_MIN;
 	}
-	if (value > SDL_JOYSTICK_AXIS_MAX) {
+	if (value >= scale->maximum) {
 		return SDL_JOYSTICK_AXIS_MAX;
 	}
-	return value;
+
+	return (int)((((Sint64)value - scale->minimum) * scale->multiplier) >> AXIS_SCALE_SHIFT) + SDL_JOYSTICK_AXIS_MIN;
 }
 
-static void updateAxis(SDL_Joystick *joystick, int axis, int value)
+static void updateAxis(Uint64 timestamp, SDL_Joystick *joystick, int axis, int value)
 {
 	SDL_JoystickAxisInfo *info = &joystick->axes[axis];
-	value = AxisCorrect(value);
+	value = AxisCorrect(&joystick->hwdata->axes[axis], value);
 
 	if (info->value != value) {
 		info->value = value;
-		SDL_SendJoystickAxis(0, joystick, axis, value);
+		SDL_SendJoystickAxis(timestamp, joystick, axis, value);
 	}
 }
 
-static int updateHat(SDL_Joystick *joystick, int hat, uint32_t value)
+static int updateHat(Uint64 timestamp, SDL_Joystick *joystick, int hat, uint32_t value)
 {
 	const Uint8 position_map[9] = {
 		SDL_HAT_UP, SDL_HAT_RIGHTUP, SDL_HAT_RIGHT,
@@ -447,83 +556,61 @@ static int updateHat(SDL_Joystick *joystick, int hat, uint32_t value)
 	/* Update internal joystick state */
 	joystick->hats[hat] = value;
 #endif
-	SDL_SendJoystickHat(0, joystick, hat, value);
+	SDL_SendJoystickHat(timestamp, joystick, hat, value);
 
 	return 1;
 }
 
+static void sendJoystickButton(void *data, int button, int pressed)
+{
+	struct joystick_hwdata *hwdata = (struct joystick_hwdata *)data;
+
+	SDL_SendJoystickButton(hwdata->timestamp, hwdata->joystick, button,
+			       pressed ? SDL_PRESSED : SDL_RELEASED);
+}
+
 int handleJoystickEvent(input_module_t *module, int data_size, void *data)
 {
 	SDL_joylist_item *item;
-	SDL_joylist_item *prev = NULL;
+	struct joystick_hwdata *hwdata;
+	SDL_Joystick *joystick;
+	int i;
 
 	pJoystick_raw_data_t j_data = (pJoystick_raw_data_t)data;
 
 	if (data_size != sizeof(*j_data))
 		return -1;
-#if 0
-	/* Find joystick item */
-	for (item = SDL_joylist; item; item = item->next) {
-		if (j_data->devno == item->devnum) {
-			break;
-		}
-	}
 
-	if (item == NULL)
-		return -1;
-#endif
-	SDL_Joystick *joystick = g_joystick;
+	/* Keeps the device list and the opened joystick alive while dispatching */
+	SDL_LockJoysticks();
 
-	if (g_joystick == NULL)
-		return -1;
+	/* Find joystick item */
+	item = GetJoystickByDevnum(j_data->devno);
 
-	//FIXME: this will not work for 2 or more devices
-	static uint64_t prevBtnStates;
-	static uint32_t prevHatState;
+	/* Nobody opened this device */
+	if (item == NULL || item->hwdata == NULL) {
+		SDL_UnlockJoysticks();
+		return -1;
+	}
 
-	uint64_t changedBtnStates;
-	int i;
+	hwdata = item->hwdata;
+	joystick = hwdata->joystick;
 
 	/* Send button press/release events */
-	changedBtnStates = prevBtnStates ^ j_data->button_state;
-	if (changedBtnStates) {
-		/* Cycle all buttons status */
-		for (i = 0; i < 64; i++) {
-			uint8_t state;
-
-			if (!((1 << i) & changedBtnStates))
-				continue;
-
-			state = ((1 << i) & j_data->button_state) ? SDL_PRESSED : SDL_RELEASED;
-
-			uint8_t button = i;
-#if 0
-			/* Make sure we're not getting garbage or duplicate events */
-			if (button >= joystick->nbuttons) {
-				continue;
-			}
-			if (state == joystick->buttons[button]) {
-				continue;
-			}
-
-			joystick->buttons[button] = state;
-#endif
-			SDL_SendJoystickButton(0, joystick, button, state);
-		}
-
-		prevBtnStates = j_data->button_state;
+	hwdata->timestamp = j_data->timestamp;
+	button_mask_diff(&hwdata->button_state, &j_data->button_state, 1,
+			 sendJoystickButton, hwdata);
+
+	/* Update axis data, only the axes this report carries */
+	for (i = 0; i < joystick->naxes; i++) {
+		if (j_data->axis_valid & (1 << i))
+			updateAxis(j_data->timestamp, joystick, i, (Sint32)j_data->axis[i]);
 	}
 
-	/* Update axis data */
-	updateAxis(joystick, 0, j_data->x);
-	updateAxis(joystick, 1, j_data->y);
-	updateAxis(joystick, 2, j_data->z);
-	updateAxis(joystick, 3, j_data->Rx);
-	updateAxis(joystick, 4, j_data->Ry);
-	updateAxis(joystick, 5, j_data->Rz);
-
 	/* Hat */
-	updateHat(joystick, 0, j_data->hat_switch);
+	updateHat(j_data->timestamp, joystick, 0, j_data->hat_switch);
+
+	SDL_UnlockJoysticks();
 
 	return 0;
 }
@@ -549,5 +636,6 @@ SDL_JoystickDriver SDL_QNX_JoystickDriver = {
 	QNX_JoystickUpdate,
 	QNX_JoystickClose,
 	QNX_JoystickQuit,
+	QNX_JoystickGetDeviceIndexForInstanceID,
 //	QNX_JoystickGetGamepadMapping
 };
@@ -216,6 +216,11 @@ typedef struct SDL_JoystickDriver
 
     /* Function to perform any system-specific joystick related cleanup */
     void (*Quit)(void);
+
+    /* Function to get the device index of a joystick instance id, or -1 if there is none.
+       Optional, when NULL every device index is checked with GetDeviceInstanceID.
+     */
+    int (*GetDeviceIndexForInstanceID)(SDL_JoystickID instance_id);
 #if 0
     /* Function to get the autodetected controller mapping; returns false if there isn't any. */
     SDL_bool (*GetGamepadMapping)(int device_index, SDL_GamepadMapping *out);
@@ -0,0 +1,54 @@
+#ifndef BUTTON_MASK_H
+#define BUTTON_MASK_H
+
+#include <stdint.h>
+
+/*
+ * Button states packed one bit per button, button N in bit N % 64 of word
+ * N / 64. Diffing only visits the buttons that changed.
+ */
+
+/* Sets the bit of a button, buttons beyond nwords words are ignored */
+static inline void button_mask_set(uint64_t *mask, int nwords, int button)
+{
+	if (button >= 0 && button < nwords * 64)
+		mask[button >> 6] |= 1ULL << (button & 63);
+}
+
+/* Returns the lowest set bit of a non-zero mask and clears it */
+static inline int button_mask_pop(uint64_t *mask)
+{
+	int bit = __builtin_ctzll(*mask);
+
+	*mask &= *mask - 1;
+
+	return bit;
+}
+
+/*
+ * Calls send(data, button, pressed) for every button whose state differs
+ * between prev and cur, in increasing button order, then copies cur to prev.
+ * Returns the number of changed buttons.
+ */
+static inline int button_mask_diff(uint64_t *prev, const uint64_t *cur, int nwords,
+				   void (*send)(void *data, int button, int pressed), void *data)
+{
+	uint64_t changed;
+	int i, bit, count = 0;
+
+	for (i = 0; i < nwords; i++) {
+		changed = prev[i] ^ cur[i];
+
+		while (changed) {
+			bit = button_mask_pop(&changed);
+			send(data, i * 64 + bit, (cur[i] >> bit) & 1);
+			count++;
+		}
+
+		prev[i] = cur[i];
+	}
+
+	return count;
+}
+
+#endif
@@ -1,7 +1,9 @@
 #include "event_queue.h"
 
 #include <stdlib.h>
-#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #ifdef DEBUG
 #define print printf
@@ -9,21 +11,420 @@
 #define print(...)
 #endif
 
-// FIXME: get rid of global mutex
-pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+/*
+ * Bounded ring of events stored by value.
+ *
+ * Each slot carries a sequence number which tells who owns it:
+ *   seq == pos             - slot is free for the producer enqueuing at pos
+ *   seq == pos + 1         - slot holds the event enqueued at pos
+ *   seq == pos + capacity  - event was dequeued, slot is free for the next lap
+ *
+ * Producers reserve a position with a CAS on head. Events normally come from
+ * the HID callback thread only, but gamepad hotplug events are also posted
+ * from the application thread during SDL_Init(), so the reservation has to be
+ * atomic. Neither side locks or allocates memory.
+ *
+ * The consumer advances tail when it removes events. With QUEUE_DROP_OLDEST a
+ * producer advances it too, to discard the front event of a full queue, but
+ * only while it holds busy = 2 on the front slot. The consumer claims the
+ * events it takes the same way, so holding the front slot keeps the producer
+ * off tail, and a producer holding it makes the consumer stop at the front.
+ *
+ * With coalescing enabled a producer may also update a published event in
+ * place. The busy flag of a slot arbitrates between it and the consumer:
+ *   0 - nobody touches the event
+ *   1 - a producer is merging into it, or the consumer is peeking at it
+ *   2 - the consumer took the event and will release the slot
+ * Neither side waits for the other: a producer skips the merge and enqueues
+ * a new event, the consumer treats the slot as not published yet.
+ */
 
-queue_t *queue_factory()
+#define queue_cas(ptr, old, new)	__sync_bool_compare_and_swap((ptr), (old), (new))
+#define queue_barrier()			__sync_synchronize()
+
+static unsigned int queue_roundup(unsigned int capacity)
+{
+	unsigned int size = 2;
+
+	while (size < capacity && size < 0x80000000u)
+		size <<= 1;
+
+	return size;
+}
+
+int queue_signal_init(queue_signal_t *sig)
+{
+	pthread_condattr_t attr;
+	int ret;
+
+	ret = pthread_mutex_init(&sig->lock, NULL);
+	if (ret != 0)
+		return -1;
+
+	/* Deadlines are CLOCK_MONOTONIC based, like the event timestamps */
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	ret = pthread_cond_init(&sig->cond, &attr);
+	pthread_condattr_destroy(&attr);
+	if (ret != 0) {
+		pthread_mutex_destroy(&sig->lock);
+		return -1;
+	}
+
+	sig->waiters = 0;
+	sig->fds[0] = sig->fds[1] = -1;
+	sig->armed = 0;
+
+	return 0;
+}
+
+void queue_signal_destroy(queue_signal_t *sig)
+{
+	if (sig->fds[0] >= 0) {
+		close(sig->fds[0]);
+		close(sig->fds[1]);
+		sig->fds[0] = sig->fds[1] = -1;
+	}
+	sig->armed = 0;
+
+	pthread_cond_destroy(&sig->cond);
+	pthread_mutex_destroy(&sig->lock);
+}
+
+/*
+ * Makes the pipe readable. A full pipe already is, anything else leaves the
+ * signal armed so the next event tries again.
+ */
+static void queue_signal_notify(queue_signal_t *sig)
+{
+	ssize_t ret;
+
+	do {
+		ret = write(sig->fds[1], "", 1);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0 && errno != EAGAIN) {
+		print("pipe write failed, errno %d\n", errno);
+		sig->armed = 1;
+	}
+}
+
+/*
+ * Called by producers after an event was published. The lock is only taken
+ * when a consumer is actually sleeping.
+ */
+void queue_signal_raise(queue_signal_t *sig)
+{
+	/* Publish the event before looking at waiters, see queue_signal_wait() */
+	queue_barrier();
+
+	/* First event since the consumer found the queues empty */
+	if (sig->armed && queue_cas(&sig->armed, 1, 0))
+		queue_signal_notify(sig);
+
+	if (!sig->waiters)
+		return;
+
+	pthread_mutex_lock(&sig->lock);
+	pthread_cond_broadcast(&sig->cond);
+	pthread_mutex_unlock(&sig->lock);
+}
+
+/*
+ * Sleeps until the signal is raised or the deadline passes, unless pending()
+ * already reports events. A NULL deadline waits forever.
+ *
+ * The waiter is registered before pending() is checked and producers check
+ * for waiters after publishing, so an event can't slip in unnoticed.
+ *
+ * Returns 0 when woken up or events are pending, ETIMEDOUT on timeout.
+ */
+int queue_signal_wait(queue_signal_t *sig, int (*pending)(void *), void *data,
+		      const struct timespec *deadline)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&sig->lock);
+	__sync_fetch_and_add(&sig->waiters, 1);
+
+	if (!pending(data)) {
+		if (deadline)
+			ret = pthread_cond_timedwait(&sig->cond, &sig->lock, deadline);
+		else
+			ret = pthread_cond_wait(&sig->cond, &sig->lock);
+	}
+
+	__sync_fetch_and_sub(&sig->waiters, 1);
+	pthread_mutex_unlock(&sig->lock);
+
+	return ret == ETIMEDOUT ? ETIMEDOUT : 0;
+}
+
+/*
+ * Returns the read end of a pipe which becomes readable when an event is
+ * published while the consumer had drained the queues. The pipe is created
+ * on first use, QNX has no eventfd. Returns -1 on error.
+ */
+int queue_signal_fd(queue_signal_t *sig, int (*pending)(void *), void *data)
 {
-	queue_t *new_queue = malloc(sizeof(queue_t));
+	int fds[2];
+
+	if (sig->fds[0] >= 0)
+		return sig->fds[0];
+
+	if (pipe(fds) != 0) {
+		print("pipe failed, errno %d\n", errno);
+		return -1;
+	}
+
+	fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+	fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+	sig->fds[1] = fds[1];
+	sig->fds[0] = fds[0];
+
+	queue_signal_arm(sig, pending, data);
+
+	return sig->fds[0];
+}
+
+/*
+ * Called by the consumer after it drained the queues: empties the pipe and
+ * arms it, so the next published event makes it readable again.
+ */
+void queue_signal_arm(queue_signal_t *sig, int (*pending)(void *), void *data)
+{
+	char buf[16];
+
+	if (sig->fds[0] < 0)
+		return;
+
+	while (read(sig->fds[0], buf, sizeof(buf)) > 0)
+		;
+
+	sig->armed = 1;
+	queue_barrier();
+
+	/* A producer that published before arming did not write, do it for it */
+	if (pending(data) && queue_cas(&sig->armed, 1, 0))
+		queue_signal_notify(sig);
+}
+
+/*
+ * Coalescing rules. Returns the key identifying events which may be merged
+ * into each other, 0 if the event must be delivered as is. Joystick events
+ * are not listed, they go to the gamepad watcher and are never queued.
+ */
+static Uint32 queue_coalesce_key(const SDL_Event *event)
+{
+	switch (event->type) {
+	case SDL_EVENT_MOUSE_MOTION:
+		return (Uint32)event->type << 16;
+	case SDL_EVENT_GAMEPAD_AXIS_MOTION:
+		return ((Uint32)event->type << 16) ^ ((Uint32)event->gaxis.which << 8) ^ event->gaxis.axis;
+	default:
+		return 0;
+	}
+}
+
+/* Merges src into the pending event dst. The timestamp of dst is kept. */
+static int queue_coalesce_merge(SDL_Event *dst, const SDL_Event *src)
+{
+	if (dst->type != src->type)
+		return 0;
+
+	switch (src->type) {
+	case SDL_EVENT_MOUSE_MOTION:
+		dst->motion.xrel += src->motion.xrel;
+		dst->motion.yrel += src->motion.yrel;
+		return 1;
+	case SDL_EVENT_GAMEPAD_AXIS_MOTION:
+		if (dst->gaxis.which != src->gaxis.which || dst->gaxis.axis != src->gaxis.axis)
+			return 0;
+		dst->gaxis.value = src->gaxis.value;
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static queue_coalesce_t *queue_coalesce_entry(queue_t *que, Uint32 key)
+{
+	return &que->coalesced[(key ^ (key >> 16)) & (QUEUE_COALESCE_SLOTS - 1)];
+}
+
+/* Moves the barrier forward to pos, never backwards */
+static void queue_set_barrier(queue_t *que, unsigned int pos)
+{
+	unsigned int cur;
+
+	do {
+		cur = que->barrier;
+		if ((int)(pos - cur) <= 0)
+			return;
+	} while (!queue_cas(&que->barrier, cur, pos));
+}
+
+/*
+ * Tries to merge the event into the last pending event with the same key.
+ * Only events queued after the last non-coalescable one qualify, so merged
+ * events never overtake a button or key event.
+ */
+static int queue_coalesce(queue_t *que, const SDL_Event *event, Uint32 key)
+{
+	queue_coalesce_t *entry = queue_coalesce_entry(que, key);
+	queue_slot_t *slot;
+	unsigned int pos = entry->pos;
+	int merged = 0;
+
+	if (entry->key != key || (int)(pos - que->barrier) < 0)
+		return 0;
+
+	slot = &que->slots[pos & que->mask];
+	if (!queue_cas(&slot->busy, 0, 1))
+		return 0;
+
+	/* Still pending, not taken by the consumer or recycled */
+	if (slot->seq == pos + 1)
+		merged = queue_coalesce_merge(&slot->event, event);
+
+	queue_barrier();
+	slot->busy = 0;
+
+	/* The consumer may have gone to sleep while the slot was busy */
+	if (merged && que->signal)
+		queue_signal_raise(que->signal);
+
+	return merged;
+}
+
+void queue_set_coalesce(queue_t *que, int enable)
+{
+	if (que == NULL)
+		return;
+
+	/* Forget events queued while coalescing was off */
+	queue_set_barrier(que, que->head);
+	que->coalesce = enable;
+}
+
+static void queue_count_drop(queue_t *que, Uint32 type)
+{
+	queue_drops_t *entry;
+	int i;
+
+	for (i = 0; i < QUEUE_DROP_TYPES; i++) {
+		entry = &que->dropped[i];
+		if (entry->type == 0)
+			queue_cas(&entry->type, 0, type + 1);
+		if (entry->type == type + 1) {
+			__sync_fetch_and_add(&entry->count, 1);
+			return;
+		}
+	}
+
+	__sync_fetch_and_add(&que->dropped_other, 1);
+}
+
+/*
+ * Returns the number of dropped events of the given type. Types that found no
+ * free entry get the count shared by all of them.
+ */
+unsigned int queue_dropped(queue_t *que, Uint32 type)
+{
+	int i;
+
+	if (que == NULL)
+		return 0;
+
+	for (i = 0; i < QUEUE_DROP_TYPES; i++) {
+		if (que->dropped[i].type == type + 1)
+			return que->dropped[i].count;
+	}
+
+	/* Once every entry is taken, other types share one counter */
+	return que->dropped_other;
+}
+
+unsigned int queue_capacity(queue_t *que)
+{
+	return que ? que->mask + 1 : 0;
+}
+
+unsigned int queue_high_water(queue_t *que)
+{
+	return que ? que->high_water : 0;
+}
+
+/*
+ * Discards the event at the front to make room, unless the consumer is
+ * taking it right now. Returns 1 if a slot was freed.
+ */
+static int queue_drop_oldest(queue_t *que)
+{
+	queue_slot_t *slot;
+	unsigned int pos;
+	Uint32 type;
+
+	pos = que->tail;
+	slot = &que->slots[pos & que->mask];
+
+	if (!queue_cas(&slot->busy, 0, 2))
+		return 0;
+
+	/* Claimed, but the consumer may have removed it meanwhile */
+	if (slot->seq != pos + 1 || que->tail != pos) {
+		queue_barrier();
+		slot->busy = 0;
+		return 0;
+	}
+
+	type = slot->event.type;
+
+	/* Holding the claim on the front slot keeps the consumer off tail */
+	slot->seq = pos + que->mask + 1;
+	queue_barrier();
+	slot->busy = 0;
+	que->tail = pos + 1;
+
+	queue_count_drop(que, type);
+
+	return 1;
+}
+
+queue_t *queue_factory(unsigned int capacity, queue_policy_t policy, queue_signal_t *signal)
+{
+	queue_t *new_queue;
+	unsigned int i, size;
+
+	if (capacity == 0)
+		capacity = QUEUE_DEFAULT_CAPACITY;
+	if (capacity > QUEUE_MAX_CAPACITY)
+		capacity = QUEUE_MAX_CAPACITY;
+	size = queue_roundup(capacity);
+
+	new_queue = calloc(1, sizeof(queue_t));
 	if (new_queue == NULL) {
 		print("Malloc failed creating the que\n");
 		return NULL;
 	}
 
-	new_queue->first = NULL;
-	new_queue->last = NULL;
+	new_queue->slots = calloc(size, sizeof(queue_slot_t));
+	if (new_queue->slots == NULL) {
+		print("Malloc failed creating %u slots\n", size);
+		free(new_queue);
+		return NULL;
+	}
+
+	for (i = 0; i < size; i++)
+		new_queue->slots[i].seq = i;
+	new_queue->mask = size - 1;
+	new_queue->signal = signal;
+	new_queue->policy = policy;
 
-	print("Generated the que @ %p\n", new_queue);
+	print("Generated the que @ %p, %u slots\n", new_queue, size);
 
 	return new_queue;
 }
@@ -35,91 +436,192 @@ void queue_destroy(queue_t *que)
 	if (que == NULL)
 		return;
 
-	print("que is not null, que = %p\n", que);
+	free(que->slots);
+	free(que);
+}
 
-	pthread_mutex_lock(&g_mutex);
-	if (que->first == NULL) {
-		print("que->first == NULL .... \n");
-		free(que);
-		pthread_mutex_unlock(&g_mutex);
-		return;
-	}
+int enque(queue_t *que, const SDL_Event *event)
+{
+	queue_slot_t *slot;
+	unsigned int pos;
+	unsigned int depth, high;
+	Uint32 key = 0;
+	int diff, track;
 
-	print("que is there lets try to free it...\n");
+	/* Coalescing state is also needed to coalesce on overflow */
+	track = que->coalesce || que->policy == QUEUE_COALESCE_THEN_DROP;
+	if (track)
+		key = queue_coalesce_key(event);
 
-	queue_node_t *_node = que->first;
+	if (key && que->coalesce && queue_coalesce(que, event, key))
+		return 0;
 
-	while (_node != NULL) {
-		// freeing the data coz it's on the heap and no one to free it
-		// except for this one
-		print("freeing : %s\n", (char *) _node->data);
-		free(_node->data);
-		queue_node_t *tmp = _node->next;
-		free(_node);
-		_node = tmp;
-	}
+	pos = que->head;
+	for (;;) {
+		slot = &que->slots[pos & que->mask];
+		diff = (int)(slot->seq - pos);
+		if (diff == 0) {
+			if (queue_cas(&que->head, pos, pos + 1))
+				break;
+		} else if (diff < 0) {
+			/* Slot still holds the event from the previous lap */
+			if (que->policy == QUEUE_DROP_OLDEST && queue_drop_oldest(que)) {
+				pos = que->head;
+				continue;
+			}
 
-	free(que);
+			if (que->policy == QUEUE_COALESCE_THEN_DROP && key &&
+			    queue_coalesce(que, event, key))
+				return 0;
 
-	pthread_mutex_unlock(&g_mutex);
-}
+			print("que %p is full, event dropped\n", que);
+			queue_count_drop(que, event->type);
+			return -1;
+		}
+		/* Another producer got this position first */
+		pos = que->head;
+	}
 
-int enque(queue_t *que, void *data)
-{
-	queue_node_t *new_node = malloc(sizeof(queue_node_t));
-	if (new_node == NULL) {
-		print("Malloc failed creating a node\n");
-		return -1;
+	/* Track the deepest the queue ever got, to size it from real loads */
+	depth = pos + 1 - que->tail;
+	while (depth > (high = que->high_water)) {
+		if (queue_cas(&que->high_water, high, depth))
+			break;
 	}
 
-	/* assuming data is in heap */
-	new_node->data = data;
-	new_node->next = NULL;
+	slot->event = *event;
+	queue_barrier();
+	slot->seq = pos + 1;
 
-	pthread_mutex_lock(&g_mutex);
-	if (que->first == NULL) {
-		/* new/empty q */
-		que->first = new_node;
-		que->last = new_node;
-	} else {
-		que->last->next = new_node;
-		que->last = new_node;
+	if (track) {
+		if (key) {
+			queue_coalesce_t *entry = queue_coalesce_entry(que, key);
+			entry->key = key;
+			entry->pos = pos;
+		} else {
+			queue_set_barrier(que, pos + 1);
+		}
 	}
-	pthread_mutex_unlock(&g_mutex);
+
+	if (que->signal)
+		queue_signal_raise(que->signal);
 
 	return 0;
 }
 
-void *deque(queue_t *que)
+int deque(queue_t *que, SDL_Event *event)
+{
+	if (queue_copy(que, 0, event, 1, 0, 0xFFFFFFFFu, ~0ULL, 1) == 0)
+		return 0;
+
+	queue_remove(que, 1);
+
+	return 1;
+}
+
+/*
+ * Returns the event offset positions behind the front without removing it,
+ * NULL if there is none. Must be called by the consumer. The result is only
+ * a hint: with QUEUE_DROP_OLDEST a producer may drop the front event and
+ * reuse its slot on a later lap at any time, so type and timestamp may be
+ * stale or torn. Callers must take events with queue_copy(), which checks
+ * the slot again. Coalescing may update the rest of the event as well.
+ */
+const SDL_Event *queue_peek(queue_t *que, unsigned int offset)
 {
-	print("Entered to deque\n");
-	if (que == NULL) {
-		print("que is null exiting...\n");
+	queue_slot_t *slot;
+	unsigned int pos;
+
+	if (que == NULL)
 		return NULL;
-	}
 
-	pthread_mutex_lock(&g_mutex);
-	if (que->first == NULL) {
-		pthread_mutex_unlock(&g_mutex);
-		print("que->first is null exiting...\n");
+	pos = que->tail + offset;
+	slot = &que->slots[pos & que->mask];
+	if (slot->seq != pos + 1 || slot->busy)
 		return NULL;
+
+	queue_barrier();
+
+	return &slot->event;
+}
+
+/*
+ * Copies up to max events starting offset positions behind the front.
+ * Stops at the first event whose type is outside [min_type, max_type] or
+ * whose timestamp is later than until. Nothing is removed: when take is set
+ * the copied events can no longer be coalesced into, and the consumer must
+ * release them with queue_remove().
+ */
+int queue_copy(queue_t *que, unsigned int offset, SDL_Event *events, int max,
+	       Uint32 min_type, Uint32 max_type, Uint64 until, int take)
+{
+	queue_slot_t *slot;
+	unsigned int pos;
+	int i, n;
+
+	if (que == NULL || max <= 0)
+		return 0;
+
+	pos = que->tail + offset;
+
+	/* Count published events first, so one barrier covers the whole run */
+	for (n = 0; n < max; n++) {
+		slot = &que->slots[(pos + n) & que->mask];
+		if (slot->seq != pos + n + 1)
+			break;
 	}
+	if (n == 0)
+		return 0;
+
+	queue_barrier();
+
+	for (i = 0; i < n; i++) {
+		slot = &que->slots[(pos + i) & que->mask];
 
-	void *data;
-	queue_node_t *_node = que->first;
-	if (que->first == que->last) {
-		que->first = NULL;
-		que->last = NULL;
-	} else {
-		que->first = _node->next;
+		/* A producer is merging into this event, leave it for the next call */
+		if (!queue_cas(&slot->busy, 0, take ? 2 : 1))
+			break;
+
+		/* The front event may have been dropped to make room */
+		if (slot->seq != pos + i + 1 ||
+		    (Uint32)slot->event.type < min_type ||
+		    (Uint32)slot->event.type > max_type ||
+		    slot->event.common.timestamp > until) {
+			queue_barrier();
+			slot->busy = 0;
+			break;
+		}
+
+		events[i] = slot->event;
+
+		if (!take) {
+			queue_barrier();
+			slot->busy = 0;
+		}
 	}
 
-	data = _node->data;
+	return i;
+}
+
+/* Releases count events from the front of the queue back to the producers */
+void queue_remove(queue_t *que, int count)
+{
+	unsigned int pos;
+	int i;
+
+	if (que == NULL || count <= 0)
+		return;
+
+	pos = que->tail;
+
+	queue_barrier();
+	for (i = 0; i < count; i++)
+		que->slots[(pos + i) & que->mask].seq = pos + i + que->mask + 1;
 
-	print("Freeing _node@ %p", _node);
-	free(_node);
-	pthread_mutex_unlock(&g_mutex);
-	print("Exiting deque\n");
+	/* Recycle the slots before dropping the claim, see queue_coalesce() */
+	queue_barrier();
+	for (i = 0; i < count; i++)
+		que->slots[(pos + i) & que->mask].busy = 0;
 
-	return data;
+	que->tail = pos + count;
 }
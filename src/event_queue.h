@@ -1,21 +1,98 @@
 #ifndef EVENT_QUEUE_H
 #define EVENT_QUEUE_H
 
-struct _node {
-	void *data;
-	struct _node *next;
+#include <SDL3/SDL_events.h>
+#include <pthread.h>
+#include <time.h>
+
+/* Number of events a queue holds when no capacity is given */
+#define QUEUE_DEFAULT_CAPACITY	1024
+#define QUEUE_MAX_CAPACITY	65536
+
+/* Number of event types with their own dropped events counter */
+#define QUEUE_DROP_TYPES	16
+
+/* Keep producer and consumer indexes on separate cache lines */
+#define QUEUE_CACHELINE_SIZE	64
+
+/* Number of pending events per queue that later events may merge into */
+#define QUEUE_COALESCE_SLOTS	16
+
+/* What enque() does when the queue is full */
+typedef enum {
+	QUEUE_DROP_NEWEST,		/* discard the event being enqueued */
+	QUEUE_DROP_OLDEST,		/* discard the event at the front */
+	QUEUE_COALESCE_THEN_DROP,	/* merge into a pending event, else discard the new one */
+} queue_policy_t;
+
+/* Wakes up consumers blocked on one or more queues */
+struct _queue_signal {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	volatile int waiters;
+	int fds[2];			/* pipe readable once events arrive, -1 if unused */
+	volatile int armed;		/* consumer saw the queues empty, next event writes the pipe */
 };
-typedef struct _node queue_node_t;
+typedef struct _queue_signal queue_signal_t;
+
+struct _queue_slot {
+	volatile unsigned int seq;	/* ring position the slot belongs to */
+	volatile int busy;		/* claimed by the consumer or a coalescing producer */
+	SDL_Event event;
+};
+typedef struct _queue_slot queue_slot_t;
+
+/* Last pending event of a coalescable kind */
+struct _queue_coalesce {
+	Uint32 key;
+	unsigned int pos;
+};
+typedef struct _queue_coalesce queue_coalesce_t;
+
+/* Dropped events of one type */
+struct _queue_drops {
+	volatile Uint32 type;		/* event type + 1, 0 if the entry is unused */
+	volatile unsigned int count;
+};
+typedef struct _queue_drops queue_drops_t;
 
 struct _evt_q {
-	queue_node_t *first;
-	queue_node_t *last;
+	volatile unsigned int head;	/* next position to enqueue */
+	char pad0[QUEUE_CACHELINE_SIZE - sizeof(unsigned int)];
+	volatile unsigned int tail;	/* next position to dequeue */
+	char pad1[QUEUE_CACHELINE_SIZE - sizeof(unsigned int)];
+	unsigned int mask;		/* capacity - 1, capacity is a power of two */
+	queue_slot_t *slots;
+	queue_signal_t *signal;		/* raised after every enque, may be NULL */
+	queue_policy_t policy;		/* overflow policy */
+	volatile unsigned int high_water;	/* most events ever queued at once */
+	volatile int coalesce;		/* merge motion events into pending ones */
+	volatile unsigned int barrier;	/* events before this position can't be merged into */
+	queue_coalesce_t coalesced[QUEUE_COALESCE_SLOTS];
+	queue_drops_t dropped[QUEUE_DROP_TYPES];
+	volatile unsigned int dropped_other;	/* types without an entry of their own */
 };
 typedef struct _evt_q queue_t;
 
-queue_t *queue_factory(void);
+int     queue_signal_init(queue_signal_t *sig);
+void    queue_signal_destroy(queue_signal_t *sig);
+void    queue_signal_raise(queue_signal_t *sig);
+int     queue_signal_wait(queue_signal_t *sig, int (*pending)(void *), void *data,
+			  const struct timespec *deadline);
+int     queue_signal_fd(queue_signal_t *sig, int (*pending)(void *), void *data);
+void    queue_signal_arm(queue_signal_t *sig, int (*pending)(void *), void *data);
+
+queue_t *queue_factory(unsigned int capacity, queue_policy_t policy, queue_signal_t *signal);
 void    queue_destroy(queue_t *que);
-int     enque(queue_t *que, void *data);
-void    *deque(queue_t *que);
+int     enque(queue_t *que, const SDL_Event *event);
+int     deque(queue_t *que, SDL_Event *event);
+const SDL_Event *queue_peek(queue_t *que, unsigned int offset);
+int     queue_copy(queue_t *que, unsigned int offset, SDL_Event *events, int max,
+		   Uint32 min_type, Uint32 max_type, Uint64 until, int take);
+void    queue_remove(queue_t *que, int count);
+void    queue_set_coalesce(queue_t *que, int enable);
+unsigned int queue_dropped(queue_t *que, Uint32 type);
+unsigned int queue_capacity(queue_t *que);
+unsigned int queue_high_water(queue_t *que);
 
 #endif
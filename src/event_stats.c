@@ -0,0 +1,155 @@
+#include "event_stats.h"
+
+#include <string.h>
+
+/*
+ * Queue residency of delivered events, from the HID report arrival time
+ * stamped into event.common.timestamp to the moment the application takes
+ * the event out of its queue.
+ *
+ * Recording is disabled by default and costs a single flag test then. When
+ * enabled, the consumer thread adds one count to a bucket and may raise the
+ * max, both with atomic operations, so several threads draining their own
+ * queues with SDL_PollQueueEvent() can record at the same time.
+ */
+
+#define stats_cas(ptr, old, new)	__sync_bool_compare_and_swap((ptr), (old), (new))
+
+static event_stats_t l_stats[SDL_EVENT_CLASS_COUNT];
+static volatile int l_stats_enabled;
+
+static int stats_class(Uint32 type)
+{
+	if (type >= SDL_EVENT_KEY_FIRST && type <= SDL_EVENT_KEY_LAST)
+		return SDL_EVENT_CLASS_KEYBOARD;
+
+	if (type >= SDL_EVENT_MOUSE_FIRST && type <= SDL_EVENT_MOUSE_LAST)
+		return SDL_EVENT_CLASS_MOUSE;
+
+	if (type >= SDL_EVENT_GAMEPAD_AXIS_MOTION && type <= SDL_EVENT_GAMEPAD_STEAM_HANDLE_UPDATED)
+		return SDL_EVENT_CLASS_GAMEPAD;
+
+	return -1;
+}
+
+static unsigned int stats_bucket(unsigned int ns)
+{
+	unsigned int exp;
+
+	if (ns < STATS_SUB_BUCKETS)
+		return ns;
+
+	exp = 31 - __builtin_clz(ns);
+
+	return (exp - STATS_SUB_BITS + 1) * STATS_SUB_BUCKETS +
+	       ((ns >> (exp - STATS_SUB_BITS)) & (STATS_SUB_BUCKETS - 1));
+}
+
+/* Largest latency that falls into the bucket */
+static Uint64 stats_bucket_limit(unsigned int bucket)
+{
+	unsigned int exp, shift;
+
+	if (bucket < STATS_SUB_BUCKETS)
+		return bucket;
+
+	exp = bucket / STATS_SUB_BUCKETS + STATS_SUB_BITS - 1;
+	shift = exp - STATS_SUB_BITS;
+
+	return ((Uint64)(STATS_SUB_BUCKETS + bucket % STATS_SUB_BUCKETS + 1) << shift) - 1;
+}
+
+void event_stats_enable(int enable)
+{
+	l_stats_enabled = enable;
+}
+
+int event_stats_enabled(void)
+{
+	return l_stats_enabled;
+}
+
+void event_stats_reset(void)
+{
+	/* Counts recorded concurrently may survive or get lost, both are fine */
+	memset((void *)l_stats, 0, sizeof(l_stats));
+}
+
+void event_stats_record(const SDL_Event *events, int count, Uint64 now)
+{
+	event_stats_t *stats;
+	unsigned int ns, max;
+	int i, cls;
+
+	if (!l_stats_enabled)
+		return;
+
+	for (i = 0; i < count; i++) {
+		cls = stats_class(events[i].type);
+		if (cls < 0)
+			continue;
+
+		/* Events pushed with a future timestamp count as delivered at once */
+		if (events[i].common.timestamp >= now)
+			ns = 0;
+		else if (now - events[i].common.timestamp > 0xFFFFFFFFULL)
+			ns = 0xFFFFFFFFu;
+		else
+			ns = (unsigned int)(now - events[i].common.timestamp);
+
+		stats = &l_stats[cls];
+		__sync_fetch_and_add(&stats->buckets[stats_bucket(ns)], 1);
+
+		do {
+			max = stats->max;
+		} while (ns > max && !stats_cas(&stats->max, max, ns));
+	}
+}
+
+void event_stats_get(SDL_EventClass cls, SDL_EventLatencyStats *stats)
+{
+	unsigned int counts[STATS_BUCKETS];
+	Uint64 sum, p50, p99;
+	int i, p50_found = 0;
+
+	memset(stats, 0, sizeof(*stats));
+
+	if (cls < 0 || cls >= SDL_EVENT_CLASS_COUNT)
+		return;
+
+	/* Work on a snapshot, so the percentiles agree with the count */
+	for (i = 0, sum = 0; i < STATS_BUCKETS; i++) {
+		counts[i] = l_stats[cls].buckets[i];
+		sum += counts[i];
+	}
+
+	stats->count = sum;
+	stats->max_ns = l_stats[cls].max;
+	if (sum == 0)
+		return;
+
+	/* Rank of the percentile, rounded up */
+	p50 = (sum * 50 + 99) / 100;
+	p99 = (sum * 99 + 99) / 100;
+
+	for (i = 0, sum = 0; i < STATS_BUCKETS; i++) {
+		if (counts[i] == 0)
+			continue;
+
+		sum += counts[i];
+		if (!p50_found && sum >= p50) {
+			stats->p50_ns = stats_bucket_limit(i);
+			p50_found = 1;
+		}
+		if (sum >= p99) {
+			stats->p99_ns = stats_bucket_limit(i);
+			break;
+		}
+	}
+
+	/* A bucket limit may exceed the largest latency really seen */
+	if (stats->p50_ns > stats->max_ns)
+		stats->p50_ns = stats->max_ns;
+	if (stats->p99_ns > stats->max_ns)
+		stats->p99_ns = stats->max_ns;
+}
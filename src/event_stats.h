@@ -0,0 +1,36 @@
+#ifndef EVENT_STATS_H
+#define EVENT_STATS_H
+
+#include <SDL3/SDL_events.h>
+
+/*
+ * Event type ranges of the keyboard and mouse events, used both to pick the
+ * event queue and the latency class of an event.
+ */
+#define SDL_EVENT_KEY_FIRST	SDL_EVENT_KEY_DOWN
+#define SDL_EVENT_KEY_LAST	(SDL_EVENT_KEY_FIRST + 0xFF)
+#define SDL_EVENT_MOUSE_FIRST	SDL_EVENT_MOUSE_MOTION
+#define SDL_EVENT_MOUSE_LAST	(SDL_EVENT_MOUSE_FIRST + 0xFF)
+
+/*
+ * Log-linear latency histogram: every power of two is split into
+ * STATS_SUB_BUCKETS linear buckets, so a bucket is at most 1/8 wide
+ * relative to its value. Latencies are kept in ns and clamped to 32 bits.
+ */
+#define STATS_SUB_BITS		3
+#define STATS_SUB_BUCKETS	(1 << STATS_SUB_BITS)
+#define STATS_BUCKETS		((32 - STATS_SUB_BITS + 1) * STATS_SUB_BUCKETS)
+
+struct _event_stats {
+	volatile unsigned int buckets[STATS_BUCKETS];
+	volatile unsigned int max;	/* largest latency recorded, ns */
+};
+typedef struct _event_stats event_stats_t;
+
+void    event_stats_enable(int enable);
+int     event_stats_enabled(void);
+void    event_stats_reset(void);
+void    event_stats_record(const SDL_Event *events, int count, Uint64 now);
+void    event_stats_get(SDL_EventClass cls, SDL_EventLatencyStats *stats);
+
+#endif
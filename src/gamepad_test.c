@@ -16,6 +16,32 @@ static int do_exit = 0;
 static SDL_Gamepad *l_controller;
 static SDL_Joystick *l_joystick;
 
+/* -b: a button held while the gamepad is opened must be reported */
+static int l_check_held;
+static Uint64 l_held_deadline;
+
+static void StartHeldButtonCheck(void)
+{
+	if (l_check_held) {
+		fprintf(stdout, "Checking for a held button, keep it pressed\n");
+		l_held_deadline = SDL_GetTicksNS() + 1000000000ULL;
+	}
+}
+
+static void CheckHeldButton(const SDL_Event *event)
+{
+	if (!l_held_deadline)
+		return;
+
+	if (event && event->type == SDL_EVENT_GAMEPAD_BUTTON_DOWN) {
+		fprintf(stdout, "PASS: held button %d reported after open\n", event->cbutton.button);
+		l_held_deadline = 0;
+	} else if (SDL_GetTicksNS() > l_held_deadline) {
+		fprintf(stdout, "FAIL: no button down within 1s of opening the gamepad\n");
+		l_held_deadline = 0;
+	}
+}
+
 const char *SDLEventName(int t)
 {
 	switch(t) {
@@ -61,6 +87,7 @@ static void HandleGamepadAdded(SDL_JoystickID id)
 			const char *path = SDL_GetGamepadPath(l_controller);
 			fprintf(stdout, "Opened gamepad %s%s%s\n",
 				name, path ? ", " : "", path ? path : "");
+			StartHeldButtonCheck();
 		}
 	}
 }
@@ -75,6 +102,8 @@ int ProcessEvent(SDL_Event *event)
 	fprintf(stdout, "Got event: %s (%d)\n",
 		SDLEventName(event->type), event->type);
 
+	CheckHeldButton(event);
+
 	switch (event->type) {
 	case SDL_MOUSEWHEEL:
 		fprintf(stdout, "MOUSE WHEEL: %02d %s\n", event->wheel.y,
@@ -173,8 +202,11 @@ int main(int argc, char *argv[]) {
 
 	fprintf(stdout, "Start gamepad tester\n");
 
-	while ((opt = getopt(argc, argv, "v:")) != -1) {
+	while ((opt = getopt(argc, argv, "bv:")) != -1) {
 		switch (opt) {
+		case 'b':
+			l_check_held = 1;
+			break;
 		case 'v':
 			verbose = atoi(optarg);
 			break;
@@ -204,6 +236,8 @@ int main(int argc, char *argv[]) {
 				if (!l_controller)
 					fprintf(stdout, "Could not open gamecontroller %i: %s\n",
 						i, SDL_GetError());
+				else
+					StartHeldButtonCheck();
 			}
 		}
 		else
@@ -224,8 +258,15 @@ int main(int argc, char *argv[]) {
 	while(!do_exit) {
 		SDL_Event event;
 
-		while (SDL_PollEvent(&event))
+		/* Sleep until input arrives, wake up periodically to check do_exit */
+		if (!SDL_WaitEventTimeout(&event, 100)) {
+			CheckHeldButton(NULL);
+			continue;
+		}
+
+		do {
 			ProcessEvent(&event);
+		} while (SDL_PollEvent(&event));
 
 		if (!l_controller)
 			continue;
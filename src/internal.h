@@ -1,6 +1,7 @@
 #ifndef __INTERNAL_H_INCLUDED__
 #define __INTERNAL_H_INCLUDED__
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,6 +12,7 @@
 #include "log.h"
 
 #include "event_queue.h"
-extern queue_t *l_evt_q;
+#include "event_stats.h"
+extern queue_t *l_evt_q[SDL_EVENT_QUEUE_COUNT];
 
 #endif // __INTERNAL_H_INCLUDED__
@@ -16,6 +16,7 @@ enum LoggerChannel
 	LOG_SDL_GAMEPAD_TRACE     = 0x0080,
 	LOG_SDL_JOYSTICK_TRACE    = 0x0100,
 	LOG_SDL_SYSJOYSTICK_TRACE = 0x0200,
+	LOG_SDL_LATENCY           = 0x0400,
 
 	/* QNX HID driver */
 	LOG_HID_INFO   = 0x08000000,
@@ -36,9 +36,11 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <stddef.h>
 
 #include <sys/devi.h>
 #include "hid.h"
+#include "../button_mask.h"
 #if 0
 #include "photon.h"
 #else
@@ -53,7 +55,7 @@
 
 // KEYBOARD
 //
-#define MAX_KEYS_IN_BUFFER	(20)	// Actually keyboard doesn't use more than 6 buttons, however we use
+#define MAX_KEYS_IN_BUFFER	(KEYBOARD_KEYS_MAX)	// Actually keyboard doesn't use more than 6 buttons, however we use
 					// this value for future expansion
 #define TIME_MASK		(0x7fffffff)
 #define REPEAT_FLAG		(0x80000000)
@@ -95,6 +97,43 @@ typedef struct _module_data
 }
 module_data_t, *pModule_data_t;
 
+// Position of a value in the raw report
+typedef struct _report_field
+{
+	_uint16 nOffset;			// Bit offset, not counting the report ID
+	_uint8 nSize;				// Size in bits(0 if the report has no such value)
+}
+report_field_t;
+
+// Report ID in front of the data: either hiddi strips it or it doesn't
+#define LAYOUT_BASE_0		(0x01)	// Data starts at the first byte
+#define LAYOUT_BASE_8		(0x02)	// Data starts after the report ID byte
+
+#define LAYOUT_VERIFY		(0)	// Compare extracted values with hiddi ones
+#define LAYOUT_READY		(1)	// Extract values from raw data
+#define LAYOUT_UNUSABLE		(2)	// Layout doesn't match, always ask hiddi
+
+#define LAYOUT_CHECKS		(32)	// Reports to verify before trusting a layout
+
+// Bits of report_verify_layout() nQueried and nFound besides the axes
+#define LAYOUT_HAT		(JOYSTICK_AXIS_MAX)
+#define LAYOUT_BUTTONS		(JOYSTICK_AXIS_MAX + 1)
+
+// Values of one report, computed from the report properties
+typedef struct _rep_layout
+{
+	_uint8 nState;				// LAYOUT_VERIFY, LAYOUT_READY or LAYOUT_UNUSABLE
+	_uint8 nBases;				// Possible data starts(LAYOUT_BASE_ flags)
+	_uint8 nBase;				// Bit offset of data once the layout is ready
+	_uint8 nChecked;			// Number of reports verified so far
+	_uint16 nBits;				// Length of the report data in bits
+	report_field_t axis[JOYSTICK_AXIS_MAX];	// X, Y, Z, Rx, Ry, Rz
+	report_field_t hat;			// Hat switch
+	report_field_t buttons;			// Button bitmap, one bit per button
+	_uint8 nButtonMin;			// Usage of the first bitmap bit
+}
+rep_layout_t, *pRep_layout_t;
+
 typedef struct _report_data
 {
 	LIST_ENTRY(_report_data) lst_conn;	// List connector
@@ -107,6 +146,10 @@ typedef struct _report_data
 	_uint16 usage;				// usage ID
 	pModule_data_t pModule;			// module descriptor this report belongs to
 	void *pPrivData;			// Pointer to device private data block(stored in module devDataLis)
+	rep_layout_t layout;			// Joystick, mouse and control reports
+	_uint16 nRepLen;			// Room for the previous report, kept right after this structure
+	_uint16 nLastLen;			// Length of the previous report(0 if none)
+	unsigned nLastGen;			// l_nReportGen when the previous report was kept
 }
 report_data_t, *pReport_data_t;
 
@@ -130,6 +173,7 @@ static struct hidd_connection *pConnection;
 
 static LIST_HEAD(_modList, _module_data) modList;	// List of the registred modules
 static pthread_mutex_t mod_mutex;	// Use this mutex for safe modules list modification
+static volatile unsigned l_nReportGen;	// Bumped to deliver the next report even if unchanged
 
 /* Prototypes+ */
 static void insertion(struct hidd_connection *, hidd_device_instance_t * instance);
@@ -143,12 +187,13 @@ static void attach_touch_reports(struct hidd_connection *pConnection, hidd_devic
 static void attach_control_reports(struct hidd_connection *pConnection, hidd_device_instance_t * pInstance, struct hidd_collection *pCollection);
 static int accept_report(struct hidd_collection *pCollection, struct hidd_device_instance *pDevInstance, _uint16 nRepIndex, _uint16 nRepType, _uint16 nConnType, pReport_data_t * ppRepData);
 static int attach_input_reports(pModule_data_t pModule, hidd_device_instance_t * pInstance, struct hidd_collection *pCollection, _uint16 nRepClass, void *pPrivData);
+static void attach_report_layouts(pModule_data_t pModule, void *pPrivData);
 
-static void report_keyboard(struct hidd_report *pReport, void *pReportData, _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData);
-static void report_mouse(struct hidd_report *pReport, void *pReportData, _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData);
-static void report_joystick(struct hidd_report *pReport, void *pReportData, _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData);
-static void report_touch(struct hidd_report *pReport, void *pReportData, _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData);
-static void report_control(struct hidd_report *pReport, void *pReportData, _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData);
+static void report_keyboard(struct hidd_report *pReport, void *pReportData, _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData, _uint64 timestamp);
+static void report_mouse(struct hidd_report *pReport, void *pReportData, _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData, _uint64 timestamp);
+static void report_joystick(struct hidd_report *pReport, void *pReportData, _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData, _uint64 timestamp);
+static void report_touch(struct hidd_report *pReport, void *pReportData, _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData, _uint64 timestamp);
+static void report_control(struct hidd_report *pReport, void *pReportData, _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData, _uint64 timestamp);
 
 static int kbd_devctrl(pModule_data_t pModule, int event, void *ptr, void *pPrivData);
 static int mouse_devctrl(pModule_data_t pModule, int event, void *ptr, void *pPrivData);
@@ -528,6 +573,10 @@ int accept_report(struct hidd_collection *pCollection,
 		(*ppRepData)->pReport = pReport;
 		(*ppRepData)->pDevInstance = pDevInstance;
 		(*ppRepData)->pCollection = pCollection;
+		memset(&(*ppRepData)->layout, 0, sizeof((*ppRepData)->layout));
+		(*ppRepData)->nRepLen = nRepLen;
+		(*ppRepData)->nLastLen = 0;
+		(*ppRepData)->nLastGen = l_nReportGen;
 	} else {
 		char *pMsgTxt = "hidd_report_attach failed(%i)\n";
 
@@ -590,6 +639,47 @@ int attach_input_reports(pModule_data_t pModule,
 	return ((NULL != LIST_FIRST_ITEM(&(pModule->inpRepList))) ? EOK : ENOENT);
 }
 
+/* Description: Service function; compares a report with the previous one of the    */
+/*              same report handle and keeps it for the next comparison             */
+/* Input      : pReport_data_t pRepData - report user data                          */
+/*              const void *pData - raw report data                                 */
+/*              _uint32 nLen - report length                                        */
+/* Output     : None                                                                */
+/* Return     : 1 if the report is a copy of the previous one, 0 otherwise          */
+/* Comment    : The previous report is stored in the extra space requested by       */
+/*              accept_report, right after report_data_t. Reports kept before the   */
+/*              last devi_hid_resend_reports call never match                       */
+static inline int report_unchanged(pReport_data_t pRepData, const void *pData, _uint32 nLen)
+{
+	_uint8 *pLast = (_uint8 *)(pRepData + 1);
+	unsigned nGen = l_nReportGen;
+
+	if (nLen > pRepData->nRepLen)
+		return 0;
+
+	if ((nLen == pRepData->nLastLen) && (nGen == pRepData->nLastGen) &&
+	    (0 == memcmp(pLast, pData, nLen)))
+		return 1;
+
+	memcpy(pLast, pData, nLen);
+	pRepData->nLastLen = nLen;
+	pRepData->nLastGen = nGen;
+
+	return 0;
+}
+
+/* Description: Makes the next report of every device pass the duplicate filter     */
+/* Input      : None                                                                */
+/* Output     : None                                                                */
+/* Return     : None                                                                */
+/* Comment    : Call after a joystick is opened or closed. Reports of a device      */
+/*              nobody had opened were dropped after the filter, so an idle pad     */
+/*              would otherwise never deliver its held buttons and axes             */
+void devi_hid_resend_reports()
+{
+	__sync_fetch_and_add(&l_nReportGen, 1);
+}
+
 /* Description: This is a callback function; HID driver calls it each time when     */
 /*              USB report comes                                                    */
 /* Input      : struct hidd_connection * - connection handler(we ignore it)         */
@@ -605,6 +695,8 @@ void report(struct hidd_connection *pConnection, struct hidd_report *handle,
 	    void *report_data, _uint32 report_len, _uint32 flags, void *user)
 {
 	pReport_data_t pRepData =(pReport_data_t) user;
+	struct timespec ts;
+	_uint64 timestamp;
 	int x;
 
 	pConnection = pConnection;
@@ -622,22 +714,39 @@ void report(struct hidd_connection *pConnection, struct hidd_report *handle,
 		printf("\n");
 	}
 
+	// Gamepads keep streaming their state while idle, a copy of it changes nothing.
+	// Mouse motion is relative and keyboard repeat is timed by reports, keep those.
+	switch (pRepData->nRepType) {
+	case HIDD_GAMEPAD_REPORT:
+	case HIDD_JOYSTICK_REPORT:
+	case HIDD_CONTROL_REPORT:
+		if (report_unchanged(pRepData, report_data, report_len))
+			return;
+		break;
+	default:
+		break;
+	}
+
+	// All events produced by this report share one arrival time
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	timestamp = (_uint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
 	switch (pRepData->nRepType) {
 	case HIDD_KEYBOARD_REPORT:
-		report_keyboard(handle, report_data, report_len, flags, pRepData);
+		report_keyboard(handle, report_data, report_len, flags, pRepData, timestamp);
 		break;
 	case HIDD_MOUSE_REPORT:
-		report_mouse(handle, report_data, report_len, flags, pRepData);
+		report_mouse(handle, report_data, report_len, flags, pRepData, timestamp);
 		break;
 	case HIDD_GAMEPAD_REPORT:
 	case HIDD_JOYSTICK_REPORT:
-		report_joystick(handle, report_data, report_len, flags, pRepData);
+		report_joystick(handle, report_data, report_len, flags, pRepData, timestamp);
 		break;
 	case HIDD_TOUCHSCREEN_REPORT:
-		report_touch(handle, report_data, report_len, flags, pRepData);
+		report_touch(handle, report_data, report_len, flags, pRepData, timestamp);
 		break;
 	case HIDD_CONTROL_REPORT:
-		report_control(handle, report_data, report_len, flags, pRepData);
+		report_control(handle, report_data, report_len, flags, pRepData, timestamp);
 		break;
 	default:
 		break;
@@ -843,6 +952,8 @@ void attach_mouse_reports(struct hidd_connection *pConnection,
 			}
 		}
 
+		attach_report_layouts(pModule, pMouseData);
+
 		pMouseData->flags = 0;
 		rc = hidd_get_protocol(pConnection, pInstance, &nProtocolId);
 		if ((EOK == rc) && (HID_PROTOCOL_REPORT == nProtocolId)) {
@@ -943,6 +1054,279 @@ void joystick_parse_props(const hidd_report_props_t *pReport_props,
 	}
 }
 
+/* Description: Service function; computes where the joystick values and buttons   */
+/*              are located in the raw report, so they can be extracted without     */
+/*              hiddi                                                               */
+/* Input      : hidd_report_props_t *pReport_props                                  */
+/*              _uint16 nNumProps                                                   */
+/* Output     : pRep_layout_t pLayout - layout of the report                        */
+/* Return     : None                                                                */
+/* Comment    : Fields are laid out in the order of the report properties. Only     */
+/*              the first run of 1-bit buttons is kept, as a bitmap of usages       */
+/*              1..64. The layout is only trusted after it is verified against      */
+/*              hiddi(see report_verify_layout)                                     */
+void report_parse_layout(const hidd_report_props_t *pReport_props,
+			 const _uint16 nNumProps,
+			 pRep_layout_t pLayout)
+{
+	_uint32 nOffset = 0, nCount;
+	_uint16 usage;
+	int i, j;
+
+	memset(pLayout, 0, sizeof(*pLayout));
+
+	for (i = 0; i < nNumProps; ++i) {
+		const hidd_report_props_t *pProps = &pReport_props[i];
+
+		// Buttons sent as a bitmap, one bit for every usage of the range
+		if ((pProps->usage_page == HIDD_PAGE_BUTTONS) && (pProps->report_size == 1) &&
+		    (0 == pLayout->buttons.nSize) && (pProps->usage_min >= 1) && (pProps->usage_min <= 64)) {
+			nCount = pProps->report_count;
+			if ((pProps->usage_max >= pProps->usage_min) && (nCount > pProps->usage_max - pProps->usage_min + 1))
+				nCount = pProps->usage_max - pProps->usage_min + 1;
+			if (nCount > 65 - pProps->usage_min)
+				nCount = 65 - pProps->usage_min;
+
+			pLayout->buttons.nOffset = nOffset;
+			pLayout->buttons.nSize = nCount;
+			pLayout->nButtonMin = pProps->usage_min;
+		}
+
+		for (j = 0; (pProps->usage_page == HIDD_PAGE_DESKTOP) && (j < pProps->report_count); ++j) {
+			// Every value of a usage range has its own usage, otherwise there is one
+			if (pProps->usage_max > pProps->usage_min)
+				usage = pProps->usage_min + j;
+			else if (j == 0)
+				usage = pProps->usage_min;
+			else
+				break;
+
+			if ((usage > pProps->usage_max) && (pProps->usage_max > pProps->usage_min))
+				break;
+
+			if ((pProps->report_size == 0) || (pProps->report_size > 32))
+				break;
+
+			if ((usage >= HIDD_USAGE_X) && (usage <= HIDD_USAGE_RZ)) {
+				pLayout->axis[usage - HIDD_USAGE_X].nOffset = nOffset + j * pProps->report_size;
+				pLayout->axis[usage - HIDD_USAGE_X].nSize = pProps->report_size;
+			} else if (usage == HIDD_USAGE_HAT_SWITCH) {
+				pLayout->hat.nOffset = nOffset + j * pProps->report_size;
+				pLayout->hat.nSize = pProps->report_size;
+			}
+		}
+
+		nOffset += pProps->report_size * pProps->report_count;
+	}
+
+	if (nOffset > 0xFFFF)
+		return;	// Leave nBases empty, the layout is never used
+
+	pLayout->nBits = nOffset;
+	pLayout->nBases = LAYOUT_BASE_0;
+	if ((nNumProps > 0) && (0 != pReport_props[0].report_id))
+		pLayout->nBases |= LAYOUT_BASE_8;
+
+	if (verbosity >= 4)
+		printf("Report layout: %u bits, report ID %u, %u buttons at bit %u\n",
+		       pLayout->nBits, nNumProps ? pReport_props[0].report_id : 0,
+		       pLayout->buttons.nSize, pLayout->buttons.nOffset);
+}
+
+/* Description: Service function; extracts a little-endian bit field from the raw   */
+/*              report                                                              */
+/* Input      : const _uint8 *pData - raw report data                               */
+/*              _uint32 nOffset - bit offset of the field                           */
+/*              _uint8 nSize - field size in bits(1..32)                            */
+/* Output     : None                                                                */
+/* Return     : Field value, zero-extended                                          */
+/* Comment    : None                                                                */
+static inline _uint32 report_get_bits(const _uint8 *pData, _uint32 nOffset, _uint8 nSize)
+{
+	_uint64 nValue = 0;
+	int i;
+
+	for (i = (nOffset + nSize - 1) >> 3; i >= (int)(nOffset >> 3); --i)
+		nValue = (nValue << 8) | pData[i];
+
+	nValue >>= nOffset & 7;
+
+	return (_uint32)(nValue & ((1ULL << nSize) - 1));
+}
+
+/* Description: Service function; extracts the button bitmap from the raw report    */
+/* Input      : const rep_layout_t *pLayout - layout of the report                  */
+/*              const _uint8 *pData - raw report data                               */
+/*              _uint32 nBase - bit offset of the report data                       */
+/* Output     : None                                                                */
+/* Return     : Button states, bit N set if button usage N + 1 is pressed           */
+/* Comment    : None                                                                */
+static inline _uint64 report_get_buttons(const rep_layout_t *pLayout, const _uint8 *pData, _uint32 nBase)
+{
+	_uint64 nButtons = 0;
+	_uint32 nOffset = nBase + pLayout->buttons.nOffset;
+	_uint8 nSize = pLayout->buttons.nSize;
+
+	if (0 == nSize)
+		return 0;
+
+	if (nSize > 32) {
+		nButtons = (_uint64)report_get_bits(pData, nOffset + 32, nSize - 32) << 32;
+		nSize = 32;
+	}
+	nButtons |= report_get_bits(pData, nOffset, nSize);
+
+	return nButtons << (pLayout->nButtonMin - 1);
+}
+
+/* Description: Service function; compares the values of one report as hiddi       */
+/*              decoded them with the values at the layout positions               */
+/* Input      : pRep_layout_t pLayout - layout of the report                        */
+/*              const _uint8 *pData - raw report data                               */
+/*              _uint32 nRepLen - report length                                     */
+/*              _uint32 nQueried - bit N is set if hiddi was asked for axis N, bit  */
+/*              LAYOUT_HAT for the hat switch, LAYOUT_BUTTONS for the buttons       */
+/*              _uint32 nFound - bit N is set if hiddi returned axis N, bit         */
+/*              LAYOUT_HAT if it returned the hat switch                            */
+/*              const _uint32 *pValues - hiddi values of axes and hat switch        */
+/*              _uint64 nButtons - hiddi button states(bit N for usage N + 1)       */
+/* Output     : None                                                                */
+/* Return     : None                                                                */
+/* Comment    : The layout becomes LAYOUT_READY once LAYOUT_CHECKS reports matched  */
+/*              and only one position of the data is possible, or LAYOUT_UNUSABLE   */
+/*              as soon as no position matches                                      */
+void report_verify_layout(pRep_layout_t pLayout, const _uint8 *pData,
+			  _uint32 nRepLen, _uint32 nQueried, _uint32 nFound,
+			  const _uint32 *pValues, _uint64 nButtons)
+{
+	const report_field_t *pField;
+	_uint32 nBase, nMask;
+	int i, nBaseFlag;
+
+	for (nBaseFlag = LAYOUT_BASE_0; nBaseFlag <= LAYOUT_BASE_8; nBaseFlag <<= 1) {
+		if (!(pLayout->nBases & nBaseFlag))
+			continue;
+
+		nBase = (nBaseFlag == LAYOUT_BASE_8) ? 8 : 0;
+
+		// The whole report data must be there
+		if (nBase + pLayout->nBits > nRepLen * 8) {
+			pLayout->nBases &= ~nBaseFlag;
+			continue;
+		}
+
+		for (i = 0; i <= JOYSTICK_AXIS_MAX; ++i) {
+			pField = (i < JOYSTICK_AXIS_MAX) ? &pLayout->axis[i] : &pLayout->hat;
+
+			if (!(nQueried & (1 << i)))
+				continue;
+
+			if (!(nFound & (1 << i)) != !pField->nSize)
+				break;
+
+			if (!pField->nSize)
+				continue;
+
+			nMask = (pField->nSize < 32) ? ((1u << pField->nSize) - 1) : ~0u;
+			if ((pValues[i] & nMask) != report_get_bits(pData, nBase + pField->nOffset, pField->nSize))
+				break;
+		}
+
+		if ((i <= JOYSTICK_AXIS_MAX) ||
+		    ((nQueried & (1 << LAYOUT_BUTTONS)) && (nButtons != report_get_buttons(pLayout, pData, nBase))))
+			pLayout->nBases &= ~nBaseFlag;
+	}
+
+	if (0 == pLayout->nBases) {
+		pLayout->nState = LAYOUT_UNUSABLE;
+		if (verbosity >= 3)
+			printf("Report layout doesn't match, using hiddi\n");
+		return;
+	}
+
+	if (pLayout->nChecked < LAYOUT_CHECKS)
+		pLayout->nChecked++;
+
+	// Both positions still match, wait for values telling them apart
+	if ((pLayout->nChecked < LAYOUT_CHECKS) || (pLayout->nBases == (LAYOUT_BASE_0 | LAYOUT_BASE_8)))
+		return;
+
+	pLayout->nBase = (pLayout->nBases == LAYOUT_BASE_8) ? 8 : 0;
+	pLayout->nState = LAYOUT_READY;
+
+	if (verbosity >= 3)
+		printf("Report layout verified, data at bit %u\n", pLayout->nBase);
+}
+
+/* Description: Service function; computes the layouts of the input reports of a    */
+/*              device                                                              */
+/* Input      : pModule_data_t pModule - module the reports are attached to         */
+/*              void *pPrivData - device private data the reports belong to         */
+/* Output     : None                                                                */
+/* Return     : None                                                                */
+/* Comment    : Reports without properties keep an empty layout, which is never     */
+/*              used                                                                */
+void attach_report_layouts(pModule_data_t pModule, void *pPrivData)
+{
+	pReport_data_t pRepData;
+	hidd_report_props_t *pReport_props;
+	_uint16 nNumProps;
+	_uint16 nPropsLen;
+
+	for (pRepData = LIST_FIRST_ITEM(&(pModule->inpRepList));
+	     NULL != pRepData; pRepData = LIST_NEXT_ITEM(pRepData, lst_conn)) {
+		// Reports of other devices served by this module
+		if (pRepData->pPrivData != pPrivData)
+			continue;
+
+		if ((EOK != hidd_get_num_props(pRepData->pRepInstance, &nNumProps)) || (0 == nNumProps))
+			continue;
+
+		nPropsLen = sizeof(hidd_report_props_t) * nNumProps;
+		pReport_props = malloc(nPropsLen);
+		if (NULL == pReport_props)
+			continue;
+
+		if (EOK == hidd_get_report_props(pRepData->pRepInstance, pReport_props, &nPropsLen))
+			report_parse_layout(pReport_props, nNumProps, &pRepData->layout);
+
+		free(pReport_props);
+	}
+}
+
+/* Description: Service function; builds the table of the axes the joystick has     */
+/* Input      : pRep_joystick_attrib_t pJoystickAttrib - abs_map, has_abs and       */
+/*              abs_correct filled by joystick_parse_props                          */
+/* Output     : pRep_joystick_attrib_t pJoystickAttrib - axes table                 */
+/* Return     : None                                                                */
+/* Comment    : None                                                                */
+void joystick_parse_axes(pRep_joystick_attrib_t pJoystickAttrib)
+{
+	struct joystick_axis *pAxis;
+	int axis;
+
+	for (axis = 0; axis < JOYSTICK_AXIS_MAX; ++axis) {
+		if (!pJoystickAttrib->has_abs[axis])
+			continue;
+
+		pAxis = &pJoystickAttrib->axes[pJoystickAttrib->abs_map[axis]];
+		pAxis->usage = axis;
+		pAxis->is_signed = (pJoystickAttrib->abs_correct[axis].minimum < 0);
+
+		// hiddi sign-extends unsigned values too, keep the bits up to the logical maximum
+		if (pAxis->is_signed) {
+			pAxis->mask = ~0u;
+		} else {
+			pAxis->mask = pJoystickAttrib->abs_correct[axis].maximum;
+			pAxis->mask |= pAxis->mask >> 1;
+			pAxis->mask |= pAxis->mask >> 2;
+			pAxis->mask |= pAxis->mask >> 4;
+			pAxis->mask |= pAxis->mask >> 8;
+			pAxis->mask |= pAxis->mask >> 16;
+		}
+	}
+}
+
 void joystick_parse_id(struct hidd_connection *pConnection,
 		       hidd_device_instance_t *pInstance,
 		       pRep_joystick_attrib_t pJoystickAttrib)
@@ -1050,6 +1434,10 @@ void attach_joystick_reports(struct hidd_connection *pConnection,
 			_uint16 nNumProps;
 			_uint16 nPropsLen;
 
+			// Reports of other devices served by this module
+			if (pRepData->pPrivData != pJoystickAttrib)
+				continue;
+
 			rc = hidd_get_num_props(pRepData->pRepInstance, &nNumProps);
 			if ((EOK != rc) || (0 == nNumProps))
 				continue; /* We cannot determine anything */
@@ -1059,13 +1447,17 @@ void attach_joystick_reports(struct hidd_connection *pConnection,
 
 			rc = hidd_get_report_props(pRepData->pRepInstance,
 						   pReport_props, &nPropsLen);
-			if (EOK == rc)
+			if (EOK == rc) {
 				joystick_parse_props(pReport_props, nNumProps,
 						     pJoystickAttrib);
+				report_parse_layout(pReport_props, nNumProps,
+						    &pRepData->layout);
+			}
 
 			free(pReport_props);
 		}
 
+		joystick_parse_axes(pJoystickAttrib);
 		joystick_parse_id(pConnection, pInstance, pJoystickAttrib);
 
 		// Call insertion callback
@@ -1158,6 +1550,8 @@ void attach_control_reports(struct hidd_connection *pConnection,
 			}
 		}
 
+		attach_report_layouts(pModule, pDeviceAttrib);
+
 		break;
 	}
 }
@@ -1257,18 +1651,21 @@ void attach_touch_reports(struct hidd_connection *pConnection,
 /*              _uint32 flags - flags(have no idea about their meanings)            */
 /*              pReport_data_t pPrivData - pointer to user data, attached to the    */
 /*              report                                                              */
+/*              _uint64 timestamp - report arrival time(CLOCK_MONOTONIC, nsecs)     */
 /* Output     : None                                                                */
 /* Return     : None                                                                */
 /* Comment    : None                                                                */
 void report_keyboard(struct hidd_report *pReport, void *pReportData,
-		     _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData)
+		     _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData,
+		     _uint64 timestamp)
 {
 	pRep_keyboard_data_t pKbdData;
 	_uint16 usages[MAX_KEYS_IN_BUFFER];
-	_uint16 pressed[MAX_KEYS_IN_BUFFER + 1];	// We don't use the first item of array for storing usages
-	_uint16 released[MAX_KEYS_IN_BUFFER + 1];	// We don't use the first item of array for storing usages
+	keyboard_raw_data_t pressedData;	// We don't use the first item of keys array for storing usages
+	keyboard_raw_data_t releasedData;	// We don't use the first item of keys array for storing usages
+	_uint16 *pressed = pressedData.keys;
+	_uint16 *released = releasedData.keys;
 	_uint16 nKeys, nPressed, nRealPressed, nReleased;
-	struct timespec timestamp;
 	_uint32 tNow;
 	int i;
 	input_module_t *pInput_module;	// Pointer to input module descriptor
@@ -1287,8 +1684,7 @@ void report_keyboard(struct hidd_report *pReport, void *pReportData,
 				    pReportData, usages, &nKeys))
 		return;
 
-	clock_gettime (CLOCK_REALTIME, &timestamp);	// Current time
-	tNow = MSEC(timestamp);	// Convert it to msecs
+	tNow = (_uint32)(timestamp / 1000000);	// Report time in msecs
 
 	/* Europe 1 shares the same make/break codes as the "\ |" key, our lookup table doesn't handle the Europe 1 key correctly, so
 	   convert the Usage ID so we can correctly handle this key in the lookup table. */
@@ -1365,6 +1761,7 @@ void report_keyboard(struct hidd_report *pReport, void *pReportData,
 	// an array of pressed or an array of released keys
 	pressed[0] = 1;
 	released[0] = 0;
+	pressedData.timestamp = releasedData.timestamp = timestamp;
 	pInput_module = pPrivData->pModule->pInput_module;
 
 	if (verbosity >= 5)
@@ -1372,14 +1769,16 @@ void report_keyboard(struct hidd_report *pReport, void *pReportData,
 
 	if (nPressed > 0) {
 		(pInput_module->input)(pInput_module,
+				       offsetof(keyboard_raw_data_t, keys) +
 				       sizeof(pressed[0]) *(nPressed + 1),
-				       (void *) pressed);
+				       (void *) &pressedData);
 	}
 
 	if (nReleased > 0) {
 		(pInput_module->input)(pInput_module,
+				       offsetof(keyboard_raw_data_t, keys) +
 				       sizeof(released[0]) *(nReleased + 1),
-				       (void *) released);
+				       (void *) &releasedData);
 	}
 }
 
@@ -1390,11 +1789,13 @@ void report_keyboard(struct hidd_report *pReport, void *pReportData,
 /*              _uint32 flags - flags(have no idea about their meanings)            */
 /*              pReport_data_t pPrivData - pointer to user data, attached to the    */
 /*              report                                                              */
+/*              _uint64 timestamp - report arrival time(CLOCK_MONOTONIC, nsecs)     */
 /* Output     : None                                                                */
 /* Return     : None                                                                */
 /* Comment    : None                                                                */
 void report_mouse(struct hidd_report *pReport, void *pReportData,
-		  _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData)
+		  _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData,
+		  _uint64 timestamp)
 {
 	pRep_mouse_data_t pMouseData;
 	_uint16 usages[MAX_BUTTONS];
@@ -1410,6 +1811,8 @@ void report_mouse(struct hidd_report *pReport, void *pReportData,
 	};
 	input_module_t *pInput_module; // Pointer to input module descriptor
 	mouse_raw_data_t mouseRawData;
+	pRep_layout_t pLayout;
+	_uint64 nButtons = 0;
 
 	flags = flags;
 
@@ -1417,25 +1820,34 @@ void report_mouse(struct hidd_report *pReport, void *pReportData,
 	if (NULL == pMouseData)
 		return;
 
-	// Is there buttons data?
-	mouseRawData.btnStates = 0;
+	mouseRawData.timestamp = timestamp;
 
-	nKeys = sizeof(usages) / sizeof(usages[0]);
+	// Is there buttons data?
+	pLayout = &pPrivData->layout;
+	if ((LAYOUT_READY == pLayout->nState) && (pLayout->nBase + pLayout->nBits <= nRepLen * 8)) {
+		nButtons = report_get_buttons(pLayout, pReportData, pLayout->nBase);
+	} else {
+		nKeys = sizeof(usages) / sizeof(usages[0]);
 
-	if (EOK == hidd_get_buttons(pPrivData->pRepInstance,
-				    pPrivData->pCollection,
-				    HIDD_PAGE_BUTTONS,
-				    pReportData, usages, &nKeys)) {
+		if (EOK == hidd_get_buttons(pPrivData->pRepInstance,
+					    pPrivData->pCollection,
+					    HIDD_PAGE_BUTTONS,
+					    pReportData, usages, &nKeys)) {
 
-		for (i = 0; i < nKeys; ++i) {
-			int nInd = usages[i] - 1; // Button usages start from 1
+			for (i = 0; i < nKeys; ++i) {
+				int nInd = usages[i] - 1; // Button usages start from 1
 #if 0
-			assert(nInd < ARRAY_SIZE(aButtonFlags));
-			mouseRawData.btnStates |= aButtonFlags[nInd];
+				assert(nInd < ARRAY_SIZE(aButtonFlags));
+				mouseRawData.btnStates |= aButtonFlags[nInd];
 #endif
-			mouseRawData.btnStates |= (1 << nInd);
+				button_mask_set(&nButtons, 1, nInd);
+			}
 		}
+
+		if (LAYOUT_VERIFY == pLayout->nState)
+			report_verify_layout(pLayout, pReportData, nRepLen, 1 << LAYOUT_BUTTONS, 0, NULL, nButtons);
 	}
+	mouseRawData.btnStates = (_uint8)nButtons;
 
 	// Is there pointer data?
 	if (EOK == hidd_get_usage_value(pPrivData->pRepInstance, NULL, HIDD_PAGE_DESKTOP, HIDD_USAGE_X, pReportData, &nValue))
@@ -1480,11 +1892,13 @@ void report_mouse(struct hidd_report *pReport, void *pReportData,
 /*              _uint32 flags - flags(have no idea about their meanings)            */
 /*              pReport_data_t pPrivData - pointer to user data, attached to the    */
 /*              report                                                              */
+/*              _uint64 timestamp - report arrival time(CLOCK_MONOTONIC, nsecs)     */
 /* Output     : None                                                                */
 /* Return     : None                                                                */
 /* Comment    : None                                                                */
 void report_joystick(struct hidd_report *pReport, void *pReportData,
-		     _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData)
+		     _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData,
+		     _uint64 timestamp)
 {
 	pRep_joystick_attrib_t pJoystickData;
 	_uint16 usages[JOYSTICK_BUTTON_MAX];
@@ -1494,8 +1908,11 @@ void report_joystick(struct hidd_report *pReport, void *pReportData,
 
 	input_module_t *pInput_module;  // Pointer to input module descriptor
 	joystick_raw_data_t raw_data;
+	const struct joystick_axis *pAxis;
+	pRep_layout_t pLayout;
 
 	memset(&raw_data, 0, sizeof(raw_data));
+	raw_data.timestamp = timestamp;
 	
 	flags = flags;
 
@@ -1503,57 +1920,86 @@ void report_joystick(struct hidd_report *pReport, void *pReportData,
 	if (NULL == pJoystickData)
 		return;
 
-// Is there buttons data?
-
-	nKeys = sizeof(usages) / sizeof(usages[0]);
-
-	if (EOK == hidd_get_buttons(pPrivData->pRepInstance, pPrivData->pCollection, HIDD_PAGE_BUTTONS, pReportData, usages, &nKeys)) {
-		if (nKeys)
-			for (i = 0; i < nKeys; ++i) {
-				raw_data.button_state |= 1 << (usages[i] - 1);
-			}
-	}
+	raw_data.devno = pJoystickData->devno;
 
 	/*
 	 * https://forums.openqnx.com/t/topic/38277/10
 	 * Of course, this fucking 20 year old bug is still there
 	 * And we must masking a returned value with absolute maximum from hid report
 	 */
+	pLayout = &pPrivData->layout;
+	if ((LAYOUT_READY == pLayout->nState) && (pLayout->nBase + pLayout->nBits <= nRepLen * 8)) {
+		// Extract values straight from the raw report
+		for (i = 0; i < pJoystickData->naxis; ++i) {
+			pAxis = &pJoystickData->axes[i];
+			if (0 == pLayout->axis[pAxis->usage].nSize)
+				continue;
+
+			nValue = report_get_bits(pReportData, pLayout->nBase + pLayout->axis[pAxis->usage].nOffset,
+						 pLayout->axis[pAxis->usage].nSize);
+			if (pAxis->is_signed && (pLayout->axis[pAxis->usage].nSize < 32) &&
+			    (nValue >> (pLayout->axis[pAxis->usage].nSize - 1)))
+				nValue |= ~0u << pLayout->axis[pAxis->usage].nSize;
+
+			raw_data.axis[i] = nValue & pAxis->mask;
+			raw_data.axis_valid |= 1 << i;
+		}
 
-	/* Fetch positional data */
-	if (EOK == hidd_get_usage_value(pPrivData->pRepInstance, NULL, HIDD_PAGE_DESKTOP, HIDD_USAGE_X, pReportData, &nValue))
-		raw_data.x = nValue & pJoystickData->abs_correct[HIDD_USAGE_X - HIDD_USAGE_X].maximum;
+		if (pLayout->hat.nSize)
+			raw_data.hat_switch = 0xF & report_get_bits(pReportData, pLayout->nBase + pLayout->hat.nOffset,
+								    pLayout->hat.nSize);
 
-	if (EOK == hidd_get_usage_value(pPrivData->pRepInstance, NULL, HIDD_PAGE_DESKTOP, HIDD_USAGE_Y, pReportData, &nValue))
-		raw_data.y = nValue & pJoystickData->abs_correct[HIDD_USAGE_Y - HIDD_USAGE_X].maximum;
+		raw_data.button_state = report_get_buttons(pLayout, pReportData, pLayout->nBase);
+	} else {
+		_uint32 aValues[JOYSTICK_AXIS_MAX + 1];
+		_uint32 nFound = 0, nQueried = (1 << LAYOUT_HAT) | (1 << LAYOUT_BUTTONS);
 
-	if (EOK == hidd_get_usage_value(pPrivData->pRepInstance, NULL, HIDD_PAGE_DESKTOP, HIDD_USAGE_Z, pReportData, &nValue))
-		raw_data.z = nValue & pJoystickData->abs_correct[HIDD_USAGE_Z - HIDD_USAGE_X].maximum;
+		// Is there buttons data?
+		nKeys = sizeof(usages) / sizeof(usages[0]);
 
-	/* Fetch rotational data */
-	if (EOK == hidd_get_usage_value(pPrivData->pRepInstance, NULL, HIDD_PAGE_DESKTOP, HIDD_USAGE_RX, pReportData, &nValue))
-		raw_data.Rx = nValue & pJoystickData->abs_correct[HIDD_USAGE_RX - HIDD_USAGE_X].maximum;
+		if (EOK == hidd_get_buttons(pPrivData->pRepInstance, pPrivData->pCollection, HIDD_PAGE_BUTTONS, pReportData, usages, &nKeys)) {
+			if (nKeys)
+				for (i = 0; i < nKeys; ++i) {
+					button_mask_set(&raw_data.button_state, 1, usages[i] - 1);
+				}
+		}
 
-	if (EOK == hidd_get_usage_value(pPrivData->pRepInstance, NULL, HIDD_PAGE_DESKTOP, HIDD_USAGE_RY, pReportData, &nValue))
-		raw_data.Ry = nValue & pJoystickData->abs_correct[HIDD_USAGE_RY - HIDD_USAGE_X].maximum;
+		/* Fetch positional and rotational data of the axes the device has */
+		for (i = 0; i < pJoystickData->naxis; ++i) {
+			pAxis = &pJoystickData->axes[i];
+			nQueried |= 1 << pAxis->usage;
 
-	if (EOK == hidd_get_usage_value(pPrivData->pRepInstance, NULL, HIDD_PAGE_DESKTOP, HIDD_USAGE_RZ, pReportData, &nValue))
-		raw_data.Rz = nValue & pJoystickData->abs_correct[HIDD_USAGE_RZ - HIDD_USAGE_X].maximum;
+			if (EOK == hidd_get_usage_value(pPrivData->pRepInstance, NULL, HIDD_PAGE_DESKTOP, HIDD_USAGE_X + pAxis->usage, pReportData, &nValue)) {
+				raw_data.axis[i] = nValue & pAxis->mask;
+				raw_data.axis_valid |= 1 << i;
+				aValues[pAxis->usage] = nValue;
+				nFound |= 1 << pAxis->usage;
+			}
+		}
 
-	/* Fetch slider data */
-//	if (EOK == hidd_get_usage_value(pPrivData->pRepInstance, NULL, HIDD_PAGE_DESKTOP, HIDD_USAGE_SLIDER, pReportData, &nValue))
-//		raw_data.slider = (_int16)nValue;
+		/* Fetch slider data */
+//		if (EOK == hidd_get_usage_value(pPrivData->pRepInstance, NULL, HIDD_PAGE_DESKTOP, HIDD_USAGE_SLIDER, pReportData, &nValue))
+//			raw_data.slider = (_int16)nValue;
 
-	/* Fetch HAT data */
-	if (EOK == hidd_get_usage_value(pPrivData->pRepInstance, NULL, HIDD_PAGE_DESKTOP, HIDD_USAGE_HAT_SWITCH, pReportData, &nValue))
-		raw_data.hat_switch = 0xF & nValue;
-/*	if ( !hidd_get_scaled_usage_value(pPrivData->pRepInstance, NULL, 1, HIDD_USAGE_HAT_SWITCH, pReportData, &nValue) )
-		fprintf( stderr, "Scaled hatswtch=%d\n", nValue);
+		/* Fetch HAT data */
+		if (EOK == hidd_get_usage_value(pPrivData->pRepInstance, NULL, HIDD_PAGE_DESKTOP, HIDD_USAGE_HAT_SWITCH, pReportData, &nValue)) {
+			raw_data.hat_switch = 0xF & nValue;
+			aValues[LAYOUT_HAT] = nValue;
+			nFound |= 1 << LAYOUT_HAT;
+		}
+/*		if ( !hidd_get_scaled_usage_value(pPrivData->pRepInstance, NULL, 1, HIDD_USAGE_HAT_SWITCH, pReportData, &nValue) )
+			fprintf( stderr, "Scaled hatswtch=%d\n", nValue);
 
 */
+		if (LAYOUT_VERIFY == pLayout->nState)
+			report_verify_layout(pLayout, pReportData, nRepLen, nQueried, nFound, aValues,
+					     raw_data.button_state);
+	}
+
 	if (verbosity >= 5)
-		fprintf(stdout, "Raw joystick data: x:%04u, y:%04u, z:%04u, buttons:%llu, Rx:%d, Ry:%d, Rz:%d, Slider:%d, Hat Switch:%d\n",
-			raw_data.x, raw_data.y, raw_data.z, raw_data.button_state, raw_data.Rx, raw_data.Ry, raw_data.Rz, raw_data.slider, raw_data.hat_switch);
+		fprintf(stdout, "Raw joystick data: axes(%#x):%04u %04u %04u %04u %04u %04u, buttons:%llu, Slider:%d, Hat Switch:%d\n",
+			raw_data.axis_valid, raw_data.axis[0], raw_data.axis[1], raw_data.axis[2], raw_data.axis[3], raw_data.axis[4], raw_data.axis[5],
+			raw_data.button_state, raw_data.slider, raw_data.hat_switch);
 
 	// And send data to input module. Joystick data must be transferred _data_t
 	// structure(see hid.h)
@@ -1570,11 +2016,13 @@ void report_joystick(struct hidd_report *pReport, void *pReportData,
 /*              _uint32 flags - flags(have no idea about their meanings)            */
 /*              pReport_data_t pPrivData - pointer to user data, attached to the    */
 /*              report                                                              */
+/*              _uint64 timestamp - report arrival time(CLOCK_MONOTONIC, nsecs)     */
 /* Output     : None                                                                */
 /* Return     : None                                                                */
 /* Comment    : None                                                                */
 void report_touch(struct hidd_report *pReport, void *pReportData,
-		  _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData)
+		  _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData,
+		  _uint64 timestamp)
 {
 	_uint32 nValue;
 	_uint16 nKeys;
@@ -1585,6 +2033,7 @@ void report_touch(struct hidd_report *pReport, void *pReportData,
 	touch_raw_data_t touchRawData;
 
 	memset(&touchRawData, 0, sizeof(touchRawData));
+	touchRawData.timestamp = timestamp;
 
 	flags = flags;
 
@@ -1635,11 +2084,13 @@ void report_touch(struct hidd_report *pReport, void *pReportData,
 /*              _uint32 flags - flags(have no idea about their meanings)            */
 /*              pReport_data_t pPrivData - pointer to user data, attached to the    */
 /*              report                                                              */
+/*              _uint64 timestamp - report arrival time(CLOCK_MONOTONIC, nsecs)     */
 /* Output     : None                                                                */
 /* Return     : None                                                                */
 /* Comment    : None                                                                */
 void report_control(struct hidd_report *pReport, void *pReportData,
-		    _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData)
+		    _uint32 nRepLen, _uint32 flags, pReport_data_t pPrivData,
+		    _uint64 timestamp)
 {
 	pRep_control_attrib_t pMouseData;
 	_uint16 usages[32];
@@ -1649,8 +2100,11 @@ void report_control(struct hidd_report *pReport, void *pReportData,
 
 	input_module_t *pInput_module; // Pointer to input module descriptor
 	control_raw_data_t raw_data;
+	pRep_layout_t pLayout;
+	_uint64 nButtons = 0;
 
 	memset(&raw_data, 0, sizeof(raw_data));
+	raw_data.timestamp = timestamp;
 
 	flags = flags;
 
@@ -1660,19 +2114,28 @@ void report_control(struct hidd_report *pReport, void *pReportData,
 
 	// Is there buttons data?
 
-	nKeys = sizeof(usages) / sizeof(usages[0]);
-
 	if (pPrivData->pRepInstance == NULL)
 		fprintf(stderr, "Instance is NULL\n");
 
-	if (EOK == hidd_get_buttons(pPrivData->pRepInstance,
-				    pPrivData->pCollection, HIDD_PAGE_BUTTONS,
-				    pReportData, usages, &nKeys)) {
-		if (nKeys)
-			for (i = 0; i < nKeys; ++i) {
-				raw_data.button_state |= 1 << (usages[i] - 1);
-			}
+	pLayout = &pPrivData->layout;
+	if ((LAYOUT_READY == pLayout->nState) && (pLayout->nBase + pLayout->nBits <= nRepLen * 8)) {
+		nButtons = report_get_buttons(pLayout, pReportData, pLayout->nBase);
+	} else {
+		nKeys = sizeof(usages) / sizeof(usages[0]);
+
+		if (EOK == hidd_get_buttons(pPrivData->pRepInstance,
+					    pPrivData->pCollection, HIDD_PAGE_BUTTONS,
+					    pReportData, usages, &nKeys)) {
+			if (nKeys)
+				for (i = 0; i < nKeys; ++i) {
+					button_mask_set(&nButtons, 1, usages[i] - 1);
+				}
+		}
+
+		if (LAYOUT_VERIFY == pLayout->nState)
+			report_verify_layout(pLayout, pReportData, nRepLen, 1 << LAYOUT_BUTTONS, 0, NULL, nButtons);
 	}
+	raw_data.button_state = (_uint32)nButtons;
 
 	/* Fetch rotational data */
 	if (EOK == hidd_get_usage_value(pPrivData->pRepInstance, NULL,
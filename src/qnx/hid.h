@@ -51,6 +51,14 @@ typedef struct _hid_keyboard_data {
 	_uint16 nDelay;                 /* Delay time interval (in msecs)       */
 } hid_keyboard_data_t, *pHid_keyboard_data_t;
 
+#define KEYBOARD_KEYS_MAX 20
+
+typedef struct _keyboard_raw_data {
+	_uint64 timestamp;              /* Report arrival time (CLOCK_MONOTONIC, ns) */
+
+	_uint16 keys[KEYBOARD_KEYS_MAX + 1];	/* keys[0] == 1 if keys were pressed, 0 if released; usages follow */
+} keyboard_raw_data_t, *pKeyboard_raw_data_t;
+
 
 
 /*******************************************************************************
@@ -65,6 +73,8 @@ typedef struct _mouse_data {
 } mouse_data_t, *pMouse_data_t;
 
 typedef struct _mouse_raw_data {
+	_uint64 timestamp;              /* Report arrival time (CLOCK_MONOTONIC, ns) */
+
 	_uint8  btnStates;              /* Buttons states (each bit == 1 corresponds to pressed button */
 
 	_int16 x;                       /* pointer x-movement                   */
@@ -102,6 +112,14 @@ typedef struct _joystick_attrib {
 		int maximum;
 	} abs_correct[JOYSTICK_AXIS_MAX];
 
+	/* Axes the device has, in SDL order: axes[abs_map[n]] describes usage HIDD_USAGE_X + n */
+	struct joystick_axis
+	{
+		_uint8 usage;           /* HIDD_USAGE_X based usage of the axis */
+		_uint8 is_signed;       /* Logical minimum is negative, the value is sign-extended */
+		_uint32 mask;           /* Applied to the raw value, see report_joystick() */
+	} axes[JOYSTICK_AXIS_MAX];
+
 	_uint8 has_hat;
 
 	struct hat_axis_correct
@@ -113,23 +131,21 @@ typedef struct _joystick_attrib {
 } joystick_attrib_t, *pJoystick_attrib_t;
 
 typedef struct _joystick_data {
+	_uint64 timestamp;              /* Report arrival time (CLOCK_MONOTONIC, ns) */
+	_Uint32t devno;                 /* Device the report comes from (see joystick_attrib_t) */
+
 //	_uint16 nButtons_1;             /* Number of buttons                                           */
 	_uint8  btnStates_1;            /* Buttons states (each bit == 1 corresponds to pressed button */
 	_uint64 button_state;
 //	_uint16 nButtons_2;             /* Number of buttons                                           */
 	_uint8  btnStates_2;            /* Buttons states (each bit == 1 corresponds to pressed button */
-	/* Pointer    */
-	_uint32 x;
-	_uint32 y;
-	_uint32 z;
+	/* Axes in SDL order (see joystick_attrib_t axes), signed axes hold an _int32 */
+	_uint32 axis[JOYSTICK_AXIS_MAX];
+	_uint8  axis_valid;             /* Bit n is set if axis[n] is part of this report */
 	/* Hat switch */
 	_uint32 hat_switch;
 	/* Slider   */
 	_uint32 slider;
-	/* Rotational */
-	_uint32 Rx;
-	_uint32 Ry;
-	_uint32 Rz;
 } joystick_raw_data_t, * pJoystick_raw_data_t;
 
 
@@ -145,6 +161,8 @@ typedef struct _touch_attrib {
 } touch_attrib_t, *pTouch_attrib_t;
 
 typedef struct _touch_raw_data {
+	_uint64 timestamp;              /* Report arrival time (CLOCK_MONOTONIC, ns) */
+
 	_uint8 touched;                 /* 1 if screen yes, otherwise 0         */
 
 	_int16 x;                       /* Absolute x-position                  */
@@ -165,6 +183,8 @@ typedef struct _control_attrib {
 } control_attrib_t, *pControl_attrib_t;
 
 typedef struct _control_raw_data {
+	_uint64 timestamp;              /* Report arrival time (CLOCK_MONOTONIC, ns) */
+
 	_uint32 button_state;
 
 	_int16 Rx;
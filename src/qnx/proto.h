@@ -120,6 +120,9 @@ int devi_hid_server_connect(char * serv_path_name);
 /* Disconnects client from USB HID server */
 void devi_hid_server_disconnect();
 
+/* Delivers the next report of every device even if it did not change */
+void devi_hid_resend_reports();
+
 /* This function attach client to HID USB sub-system.  Register your client from
  * reset function of each device module. If nDev >= 0, it specifies device number.
  * Function returns local module handler
@@ -6,9 +6,13 @@
 #include "SDL_gamepad_c.h"
 
 #include <ctype.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
 
 int verbosity; /* QNX hid driver log level */
-queue_t *l_evt_q; /* SDL event queue */
+queue_t *l_evt_q[SDL_EVENT_QUEUE_COUNT]; /* SDL event queues, one per device class */
+static queue_signal_t l_evt_signal; /* wakes up SDL_WaitEvent() */
 
 extern int handleMouseEvent(input_module_t *module, int data_size, void * data);
 extern int handleJoystickEvent(input_module_t *module, int data_size, void * data);
@@ -121,19 +125,266 @@ int SDL_vasprintf(char **strp, SDL_PRINTF_FORMAT_STRING const char *fmt, va_list
 	}
 }
 
+Uint64 SDL_GetTicksNS(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (Uint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static SDL_EventQueue SDL_GetEventQueueForType(Uint32 type)
+{
+	if (type >= SDL_EVENT_KEY_FIRST && type <= SDL_EVENT_KEY_LAST)
+		return SDL_EVENT_QUEUE_KEYBOARD;
+
+	if (type >= SDL_EVENT_MOUSE_FIRST && type <= SDL_EVENT_MOUSE_LAST)
+		return SDL_EVENT_QUEUE_MOUSE;
+
+	return SDL_EVENT_QUEUE_GAMEPAD;
+}
+
+/* Whether the queue may hold events with a type within [minType, maxType] */
+static SDL_bool SDL_EventQueueHasTypes(SDL_EventQueue queue, Uint32 minType, Uint32 maxType)
+{
+	switch (queue) {
+	case SDL_EVENT_QUEUE_KEYBOARD:
+		return minType <= SDL_EVENT_KEY_LAST && maxType >= SDL_EVENT_KEY_FIRST;
+	case SDL_EVENT_QUEUE_MOUSE:
+		return minType <= SDL_EVENT_MOUSE_LAST && maxType >= SDL_EVENT_MOUSE_FIRST;
+	default:
+		return minType < SDL_EVENT_KEY_FIRST || maxType > SDL_EVENT_MOUSE_LAST;
+	}
+}
+
+int SDL_PushEvent(SDL_Event *event)
+{
+	queue_t *que = l_evt_q[SDL_GetEventQueueForType(event->type)];
+
+	if (!que)
+		return 0;
+
+	if (event->common.timestamp == 0)
+		event->common.timestamp = SDL_GetTicksNS();
+
+	if (enque(que, event) < 0) {
+		LOG(LOG_WARNING, "%s event queue is full, event 0x%x dropped\n",
+		    __func__, event->type);
+		return -1;
+	}
+
+	return 1;
+}
+
+static int SDL_HasPendingEvents(void *unused)
+{
+	int i;
+
+	for (i = 0; i < SDL_EVENT_QUEUE_COUNT; i++) {
+		if (queue_peek(l_evt_q[i], 0))
+			return 1;
+	}
+
+	return 0;
+}
+
+int SDL_PeepEvents(SDL_Event *events, int numevents, SDL_eventaction action,
+		   Uint32 minType, Uint32 maxType)
+{
+	unsigned int offset[SDL_EVENT_QUEUE_COUNT] = { 0 };
+	const SDL_Event *front;
+	Uint64 oldest, bound;
+	int i, n, best, used = 0;
+
+	if (action == SDL_ADDEVENT) {
+		for (used = 0; used < numevents; used++) {
+			if (SDL_PushEvent(&events[used]) != 1)
+				break;
+		}
+		return used;
+	}
+
+	while (used < numevents) {
+		/*
+		 * Pick the queue with the oldest matching front event. Everything it
+		 * holds up to the next oldest front of the other queues can be
+		 * copied in one run.
+		 */
+		best = -1;
+		oldest = bound = ~0ULL;
+		for (i = 0; i < SDL_EVENT_QUEUE_COUNT; i++) {
+			if (!SDL_EventQueueHasTypes(i, minType, maxType))
+				continue;
+
+			front = queue_peek(l_evt_q[i], offset[i]);
+			if (!front || (Uint32)front->type < minType || (Uint32)front->type > maxType)
+				continue;
+
+			if (best < 0 || front->common.timestamp < oldest) {
+				bound = oldest;
+				oldest = front->common.timestamp;
+				best = i;
+			} else if (front->common.timestamp < bound) {
+				bound = front->common.timestamp;
+			}
+		}
+
+		if (best < 0)
+			break;
+
+		n = queue_copy(l_evt_q[best], offset[best], &events[used],
+			       numevents - used, minType, maxType, bound,
+			       action == SDL_GETEVENT);
+
+		/* The peeked front was a hint, it was dropped or is being merged into */
+		if (n == 0)
+			break;
+
+		offset[best] += n;
+		used += n;
+	}
+
+	if (action == SDL_GETEVENT) {
+		for (i = 0; i < SDL_EVENT_QUEUE_COUNT; i++)
+			queue_remove(l_evt_q[i], offset[i]);
+
+		if (used > 0 && event_stats_enabled())
+			event_stats_record(events, used, SDL_GetTicksNS());
+
+		/* Everything was drained, let the next event wake up SDL_GetEventFD() users */
+		if (used < numevents && !SDL_HasPendingEvents(NULL))
+			queue_signal_arm(&l_evt_signal, SDL_HasPendingEvents, NULL);
+	}
+
+	return used;
+}
+
 int SDL_PollEvent(SDL_Event * event)
 {
-	SDL_Event *ev = deque(l_evt_q);
+	return SDL_PeepEvents(event, 1, SDL_GETEVENT, SDL_EVENT_FIRST, SDL_EVENT_LAST) == 1;
+}
+
+int SDL_WaitEventTimeout(SDL_Event *event, Sint32 timeoutMS)
+{
+	struct timespec deadline;
+	Uint64 end = 0;
+
+	if (!l_evt_q[0])
+		return 0;
+
+	if (timeoutMS > 0) {
+		end = SDL_GetTicksNS() + (Uint64)timeoutMS * 1000000ULL;
+		deadline.tv_sec = end / 1000000000ULL;
+		deadline.tv_nsec = end % 1000000000ULL;
+	}
+
+	for (;;) {
+		if (event ? SDL_PollEvent(event) : SDL_HasPendingEvents(NULL))
+			return 1;
+
+		if (timeoutMS == 0)
+			return 0;
+
+		if (queue_signal_wait(&l_evt_signal, SDL_HasPendingEvents, NULL,
+				      timeoutMS > 0 ? &deadline : NULL) == ETIMEDOUT)
+			return event ? SDL_PollEvent(event) : SDL_HasPendingEvents(NULL);
+	}
+}
+
+int SDL_WaitEvent(SDL_Event *event)
+{
+	return SDL_WaitEventTimeout(event, -1);
+}
+
+void SDL_SetEventCoalescing(SDL_bool enabled)
+{
+	int i;
 
-	if (!ev)
+	for (i = 0; i < SDL_EVENT_QUEUE_COUNT; i++)
+		queue_set_coalesce(l_evt_q[i], enabled);
+}
+
+Uint32 SDL_GetEventQueueHighWater(SDL_EventQueue queue)
+{
+	if (queue < 0 || queue >= SDL_EVENT_QUEUE_COUNT)
 		return 0;
 
-	*event = *ev;
-	free(ev);
+	return queue_high_water(l_evt_q[queue]);
+}
+
+Uint32 SDL_GetDroppedEventCount(Uint32 type)
+{
+	return queue_dropped(l_evt_q[SDL_GetEventQueueForType(type)], type);
+}
+
+int SDL_GetEventFD(void)
+{
+	if (!l_evt_q[0])
+		return -1;
+
+	return queue_signal_fd(&l_evt_signal, SDL_HasPendingEvents, NULL);
+}
+
+int SDL_PollQueueEvent(SDL_EventQueue queue, SDL_Event *event)
+{
+	if (queue < 0 || queue >= SDL_EVENT_QUEUE_COUNT)
+		return 0;
+
+	if (!deque(l_evt_q[queue], event)) {
+		/* Re-arm SDL_GetEventFD() once the other queues are drained too */
+		if (!SDL_HasPendingEvents(NULL))
+			queue_signal_arm(&l_evt_signal, SDL_HasPendingEvents, NULL);
+		return 0;
+	}
+
+	if (event_stats_enabled())
+		event_stats_record(event, 1, SDL_GetTicksNS());
 
 	return 1;
 }
 
+void SDL_SetEventLatencyStats(SDL_bool enabled)
+{
+	event_stats_enable(enabled);
+}
+
+int SDL_GetEventLatencyStats(SDL_EventClass cls, SDL_EventLatencyStats *stats)
+{
+	if (cls < 0 || cls >= SDL_EVENT_CLASS_COUNT || !stats)
+		return -1;
+
+	event_stats_get(cls, stats);
+
+	return 0;
+}
+
+void SDL_ResetEventLatencyStats(void)
+{
+	event_stats_reset();
+}
+
+static void SDL_LogEventLatencyStats(void)
+{
+	static const char *names[SDL_EVENT_CLASS_COUNT] = {
+		"keyboard", "mouse", "gamepad"
+	};
+	SDL_EventLatencyStats stats;
+	int i;
+
+	for (i = 0; i < SDL_EVENT_CLASS_COUNT; i++) {
+		event_stats_get(i, &stats);
+		if (stats.count == 0)
+			continue;
+
+		LOG(LOG_SDL_LATENCY, "Input latency %s: %llu events, p50 %llu us, p99 %llu us, max %llu us\n",
+		    names[i], (unsigned long long)stats.count,
+		    (unsigned long long)stats.p50_ns / 1000,
+		    (unsigned long long)stats.p99_ns / 1000,
+		    (unsigned long long)stats.max_ns / 1000);
+	}
+}
+
 SDL_bool SDL_IsGamepad(SDL_JoystickID instance_id)
 {
 	return 1;
@@ -154,9 +405,38 @@ Uint32 SDL_WasInit(Uint32 flags)
 
 int _init_sdl()
 {
-	l_evt_q = queue_factory();
-	if (NULL == l_evt_q)
-		LOG(LOG_ERROR, "Couldn't init event queue_t\n");
+	unsigned int capacity = QUEUE_DEFAULT_CAPACITY;
+	queue_policy_t policy = QUEUE_DROP_NEWEST;
+	const char *env;
+	int i;
+
+	env = getenv("EVENT_QUEUE_SIZE");
+	if (env != NULL)
+		capacity = (unsigned int)strtoul(env, NULL, 0);
+
+	env = getenv("EVENT_QUEUE_POLICY");
+	if (env != NULL) {
+		if (!strcmp(env, "newest"))
+			policy = QUEUE_DROP_NEWEST;
+		else if (!strcmp(env, "oldest"))
+			policy = QUEUE_DROP_OLDEST;
+		else if (!strcmp(env, "coalesce"))
+			policy = QUEUE_COALESCE_THEN_DROP;
+		else
+			LOG(LOG_WARNING, "Unknown EVENT_QUEUE_POLICY %s\n", env);
+	}
+
+	if (Log_getmask() & LOG_SDL_LATENCY)
+		event_stats_enable(1);
+
+	if (queue_signal_init(&l_evt_signal) != 0)
+		LOG(LOG_ERROR, "Couldn't init event queue signal\n");
+
+	for (i = 0; i < SDL_EVENT_QUEUE_COUNT; i++) {
+		l_evt_q[i] = queue_factory(capacity, policy, &l_evt_signal);
+		if (NULL == l_evt_q[i])
+			LOG(LOG_ERROR, "Couldn't init event queue_t %d\n", i);
+	}
 
 	LOG(LOG_INFO, "SDL initialized\n");
 }
@@ -250,6 +530,8 @@ int SDL_Init(Uint32 flags)
 
 void SDL_QuitSubSystem(Uint32 flags)
 {
+	int i;
+
 	if (flags != SDL_INIT_JOYSTICK)
 		return;
 
@@ -258,8 +540,16 @@ void SDL_QuitSubSystem(Uint32 flags)
 	devi_unregister_hid_client(g_mouse_client_h);
 	devi_hid_server_disconnect();
 
-	if (NULL != l_evt_q)
-		queue_destroy(l_evt_q);
+	for (i = 0; i < SDL_EVENT_QUEUE_COUNT; i++) {
+		LOG(LOG_INFO, "Event queue %d: %u of %u slots used at most\n", i,
+		    queue_high_water(l_evt_q[i]), queue_capacity(l_evt_q[i]));
+		queue_destroy(l_evt_q[i]);
+		l_evt_q[i] = NULL;
+	}
+	queue_signal_destroy(&l_evt_signal);
+
+	SDL_LogEventLatencyStats();
+	event_stats_enable(0);
 
 	g_is_input_init = 0;
 
@@ -0,0 +1,321 @@
+/*
+ * Compiles the built-in gamepad mappings of src/SDL_gamepad_db.h into a
+ * GUID keyed perfect hash table, written to stdout as a C header that
+ * src/SDL_gamepad.c includes.
+ *
+ * Build it for the host with the same SDL_JOYSTICK_* and SDL_PLATFORM_*
+ * defines as the library, so it sees the same s_GamepadMappings[] entries.
+ *
+ * Only mappings with a plain 32 digit GUID are hashed. The others ("xinput",
+ * "default", "hidapi", malformed ones) are listed as unhashed, the library
+ * adds them at startup like it always did.
+ *
+ * It also hashes the axis and button names of src/SDL_gamepad_names.h into
+ * the slot table the mapping parser looks element names up in.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SDL_GAMEPAD_DB_GENERATOR
+#include "SDL_gamepad_db.h"
+#include "SDL_gamepad_db_hash.h"
+#include "SDL_gamepad_names.h"
+
+#define GUID_SIZE	16
+#define MAX_SEED	0xFFFF
+
+#define NUM_AXES	(int)(sizeof(map_StringForGamepadAxis) / sizeof(map_StringForGamepadAxis[0]))
+#define NUM_ELEMENTS	(NUM_AXES + (int)(sizeof(map_StringForGamepadButton) / sizeof(map_StringForGamepadButton[0])))
+#define MIN_ELEMENT_SLOTS	128
+
+struct entry
+{
+	unsigned char guid[GUID_SIZE];	/* as written in the mapping */
+	unsigned char key[GUID_SIZE];	/* GUID with the CRC cleared */
+	int index;			/* into s_GamepadMappings */
+};
+
+static int hex_digit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/* Returns 1 if the mapping can be looked up by GUID, filling guid */
+static int parse_guid(const char *mapping, unsigned char *guid)
+{
+	const char *comma = strchr(mapping, ',');
+	int i, hi, lo;
+
+	/* The name must follow, or the library rejects the mapping */
+	if (!comma || comma - mapping != 2 * GUID_SIZE || !strchr(comma + 1, ','))
+		return 0;
+
+#if defined(SDL_PLATFORM_WIN32) || defined(SDL_PLATFORM_WINGDK)
+	/* Old style GUIDs are converted when they are added */
+	if (memcmp(&mapping[20], "504944564944", 12) == 0)
+		return 0;
+#elif defined(SDL_PLATFORM_MACOS)
+	if (memcmp(&mapping[4], "000000000000", 12) == 0 &&
+	    memcmp(&mapping[20], "000000000000", 12) == 0)
+		return 0;
+#endif
+
+	for (i = 0; i < GUID_SIZE; ++i) {
+		hi = hex_digit(mapping[2 * i]);
+		lo = hex_digit(mapping[2 * i + 1]);
+		if (hi < 0 || lo < 0)
+			return 0;
+		guid[i] = (unsigned char)(hi << 4 | lo);
+	}
+
+	return 1;
+}
+
+static unsigned int next_pow2(unsigned int n)
+{
+	unsigned int p = 1;
+
+	while (p < n)
+		p <<= 1;
+	return p;
+}
+
+static struct entry *l_entries;
+static int l_num_entries;
+static int *l_bucket_of;		/* bucket of every entry */
+static unsigned short *l_seeds;		/* seed of every bucket */
+static unsigned short *l_slots;		/* entry + 1 of every slot, 0 if free */
+
+static int by_bucket_size(const void *a, const void *b)
+{
+	const int *pa = a, *pb = b;
+
+	/* Entries of larger buckets first, then by bucket, so buckets stay together */
+	if (pa[1] != pb[1])
+		return pb[1] - pa[1];
+	return pa[0] - pb[0];
+}
+
+/* Returns 0 once every entry has a slot of its own */
+static int build_hash(unsigned int num_buckets, unsigned int num_slots)
+{
+	int (*order)[3];	/* bucket, bucket size, entry */
+	int *sizes;
+	int i, j, start, end;
+	unsigned int seed, slot;
+
+	order = calloc(l_num_entries + 1, sizeof(*order));
+	sizes = calloc(num_buckets, sizeof(*sizes));
+	free(l_seeds);
+	free(l_slots);
+	l_seeds = calloc(num_buckets, sizeof(*l_seeds));
+	l_slots = calloc(num_slots, sizeof(*l_slots));
+	if (!order || !sizes || !l_seeds || !l_slots) {
+		fprintf(stderr, "gamepad_db_gen: out of memory\n");
+		exit(1);
+	}
+
+	for (i = 0; i < l_num_entries; ++i) {
+		l_bucket_of[i] = SDL_GamepadDBHash(l_entries[i].key, 0) & (num_buckets - 1);
+		sizes[l_bucket_of[i]]++;
+	}
+	for (i = 0; i < l_num_entries; ++i) {
+		order[i][0] = l_bucket_of[i];
+		order[i][1] = sizes[l_bucket_of[i]];
+		order[i][2] = i;
+	}
+	qsort(order, l_num_entries, sizeof(*order), by_bucket_size);
+
+	/* Find a seed placing all entries of a bucket in free slots */
+	for (start = 0; start < l_num_entries; start = end) {
+		for (end = start; end < l_num_entries && order[end][0] == order[start][0]; ++end) {
+		}
+
+		for (seed = 1; seed <= MAX_SEED; ++seed) {
+			for (i = start; i < end; ++i) {
+				slot = SDL_GamepadDBHash(l_entries[order[i][2]].key, seed) & (num_slots - 1);
+				if (l_slots[slot])
+					break;
+				l_slots[slot] = order[i][2] + 1;
+			}
+			if (i == end)
+				break;
+
+			/* Undo the entries placed with this seed */
+			for (j = start; j < i; ++j)
+				l_slots[SDL_GamepadDBHash(l_entries[order[j][2]].key, seed) & (num_slots - 1)] = 0;
+		}
+		if (seed > MAX_SEED) {
+			free(order);
+			free(sizes);
+			return -1;
+		}
+		l_seeds[order[start][0]] = (unsigned short)seed;
+	}
+
+	free(order);
+	free(sizes);
+	return 0;
+}
+
+/* Axes first, then buttons, like the library numbers elements */
+static const char *element_name(int element)
+{
+	if (element < NUM_AXES)
+		return map_StringForGamepadAxis[element];
+	return map_StringForGamepadButton[element - NUM_AXES];
+}
+
+/* Returns the seed giving every element name a slot of its own, 0 if none does */
+static unsigned int build_element_table(unsigned char *slots, unsigned int num_slots)
+{
+	const char *name;
+	unsigned int seed, slot;
+	int element;
+
+	for (seed = 1; seed <= MAX_SEED; ++seed) {
+		memset(slots, 0, num_slots);
+		for (element = 0; element < NUM_ELEMENTS; ++element) {
+			name = element_name(element);
+			slot = SDL_GamepadElementHash(name, name + strlen(name), seed) & (num_slots - 1);
+			if (slots[slot])
+				break;
+			slots[slot] = (unsigned char)(element + 1);
+		}
+		if (element == NUM_ELEMENTS)
+			return seed;
+	}
+	return 0;
+}
+
+static void print_guid(const unsigned char *guid)
+{
+	int i;
+
+	printf("{ ");
+	for (i = 0; i < GUID_SIZE; ++i)
+		printf("0x%02x%s", guid[i], i < GUID_SIZE - 1 ? ", " : "");
+	printf(" }");
+}
+
+int main(void)
+{
+	int num_mappings, num_unhashed = 0;
+	int *unhashed;
+	unsigned char guid[GUID_SIZE];
+	struct entry e;
+	unsigned int num_buckets, num_slots;
+	unsigned char *element_slots = NULL;
+	unsigned int element_seed, num_element_slots;
+	int i, j;
+
+	for (num_mappings = 0; s_GamepadMappings[num_mappings]; ++num_mappings) {
+	}
+
+	l_entries = calloc(num_mappings + 1, sizeof(*l_entries));
+	l_bucket_of = calloc(num_mappings + 1, sizeof(*l_bucket_of));
+	unhashed = calloc(num_mappings + 1, sizeof(*unhashed));
+	if (!l_entries || !l_bucket_of || !unhashed) {
+		fprintf(stderr, "gamepad_db_gen: out of memory\n");
+		return 1;
+	}
+
+	for (i = 0; i < num_mappings; ++i) {
+		if (!parse_guid(s_GamepadMappings[i], guid)) {
+			unhashed[num_unhashed++] = i;
+			continue;
+		}
+
+		/*
+		 * Adding a mapping replaces any mapping with the same GUID whatever
+		 * their CRCs, so the last mapping of a GUID is the one that counts
+		 */
+		memcpy(e.guid, guid, GUID_SIZE);
+		memcpy(e.key, guid, GUID_SIZE);
+		e.key[2] = e.key[3] = 0;
+		e.index = i;
+
+		/* Lookups skip mappings without a GUID */
+		for (j = 0; j < GUID_SIZE && !e.key[j]; ++j) {
+		}
+		if (j == GUID_SIZE) {
+			unhashed[num_unhashed++] = i;
+			continue;
+		}
+
+		for (j = 0; j < l_num_entries; ++j) {
+			if (memcmp(l_entries[j].key, e.key, GUID_SIZE) == 0)
+				break;
+		}
+		l_entries[j] = e;
+		if (j == l_num_entries)
+			++l_num_entries;
+	}
+
+	/* About four entries per bucket and a slot table at most 80% full */
+	num_buckets = next_pow2((l_num_entries + 3) / 4);
+	num_slots = next_pow2(l_num_entries + l_num_entries / 4 + 1);
+	while (build_hash(num_buckets, num_slots) < 0)
+		num_slots <<= 1;
+
+	for (num_element_slots = MIN_ELEMENT_SLOTS;; num_element_slots <<= 1) {
+		free(element_slots);
+		element_slots = calloc(num_element_slots, 1);
+		if (!element_slots) {
+			fprintf(stderr, "gamepad_db_gen: out of memory\n");
+			return 1;
+		}
+		element_seed = build_element_table(element_slots, num_element_slots);
+		if (element_seed)
+			break;
+	}
+
+	printf("/* Generated by tools/gamepad_db_gen from src/SDL_gamepad_db.h, do not edit */\n\n");
+	printf("#define SDL_GAMEPAD_DB_MAPPINGS\t%d\n", num_mappings);
+	printf("#define SDL_GAMEPAD_DB_ENTRIES\t%d\n", l_num_entries);
+	printf("#define SDL_GAMEPAD_DB_BUCKETS\t%u\n", num_buckets);
+	printf("#define SDL_GAMEPAD_DB_SLOTS\t%u\n", num_slots);
+	printf("#define SDL_GAMEPAD_DB_UNHASHED\t%d\n\n", num_unhashed);
+
+	printf("static const GamepadDBEntry s_GamepadDB[SDL_GAMEPAD_DB_ENTRIES + 1] = {\n");
+	for (i = 0; i < l_num_entries; ++i) {
+		printf("\t{ ");
+		print_guid(l_entries[i].guid);
+		printf(", %d },\n", l_entries[i].index);
+	}
+	printf("\t{ { 0 }, 0 }\n};\n\n");
+
+	printf("static const Uint16 s_GamepadDBSeeds[SDL_GAMEPAD_DB_BUCKETS] = {");
+	for (i = 0; i < (int)num_buckets; ++i)
+		printf("%s%u,", i % 16 ? " " : "\n\t", l_seeds[i]);
+	printf("\n};\n\n");
+
+	printf("static const Uint16 s_GamepadDBSlots[SDL_GAMEPAD_DB_SLOTS] = {");
+	for (i = 0; i < (int)num_slots; ++i)
+		printf("%s%u,", i % 16 ? " " : "\n\t", l_slots[i]);
+	printf("\n};\n\n");
+
+	printf("static const Uint16 s_GamepadDBUnhashed[SDL_GAMEPAD_DB_UNHASHED + 1] = {");
+	for (i = 0; i < num_unhashed; ++i)
+		printf("%s%d,", i % 16 ? " " : "\n\t", unhashed[i]);
+	printf("\n\t0\n};\n\n");
+
+	printf("#define SDL_GAMEPAD_ELEMENTS\t%d\n", NUM_ELEMENTS);
+	printf("#define SDL_GAMEPAD_ELEMENT_SEED\t%u\n", element_seed);
+	printf("#define SDL_GAMEPAD_ELEMENT_SLOTS\t%u\n\n", num_element_slots);
+
+	printf("/* Element + 1 of every slot, 0 if free */\n");
+	printf("static const Uint8 s_GamepadElementSlots[SDL_GAMEPAD_ELEMENT_SLOTS] = {");
+	for (i = 0; i < (int)num_element_slots; ++i)
+		printf("%s%u,", i % 16 ? " " : "\n\t", element_slots[i]);
+	printf("\n};\n");
+
+	return 0;
+}